@@ -0,0 +1,256 @@
+#include "allocator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+// arena blocks start at a cache line
+static const size_t sBlockAlignment= Allocator::sCacheLineSize;
+
+static inline size_t alignSize(size_t bytes, size_t alignment= Allocator::sMinAlignment)
+{
+   return (bytes + alignment - 1) & ~(alignment - 1);
+}
+
+
+static inline bool isAligned(const void* data, size_t alignment)
+{
+   return ((size_t)data & (alignment - 1)) == 0;
+}
+
+
+// windows: all blocks come from _aligned_malloc() as they have to be freed by _aligned_free()
+// elsewhere: posix_memalign() memory may be passed to realloc() and free()
+class HeapAllocator : public Allocator
+{
+public:
+   virtual void* allocate(size_t bytes, size_t alignment)
+   {
+      void* data;
+#ifdef WIN32
+      data= _aligned_malloc(bytes, alignment);
+#else
+      if (alignment <= sMinAlignment)
+         data= malloc(bytes);
+      else if (posix_memalign(&data, alignment, bytes) != 0)
+         data= 0;
+#endif
+      if (!data)
+         throw std::bad_alloc();
+      return data;
+   }
+
+   virtual void* reallocate(void* data, size_t bytes, size_t newBytes, size_t alignment, size_t previousAlignment)
+   {
+#ifdef WIN32
+      // _aligned_realloc() cannot change the alignment of a block
+      if (data && alignment != previousAlignment)
+      {
+         void* result= allocate(newBytes, alignment);
+         memcpy(result, data, (bytes < newBytes) ? bytes : newBytes);
+         _aligned_free(data);
+         return result;
+      }
+
+      void* result= _aligned_realloc(data, newBytes, alignment);
+      if (!result)
+         throw std::bad_alloc();
+      return result;
+#else
+      (void)previousAlignment;
+      void* result= realloc(data, newBytes);
+      if (!result)
+         throw std::bad_alloc();
+
+      // realloc() only guarantees malloc() alignment
+      if (!isAligned(result, alignment))
+      {
+         void* aligned= allocate(newBytes, alignment);
+         memcpy(aligned, result, (bytes < newBytes) ? bytes : newBytes);
+         free(result);
+         result= aligned;
+      }
+      return result;
+#endif
+   }
+
+   virtual void release(void* data, size_t /*bytes*/)
+   {
+#ifdef WIN32
+      _aligned_free(data);
+#else
+      free(data);
+#endif
+   }
+};
+
+
+Allocator* Allocator::getHeap()
+{
+   static HeapAllocator heap;
+   return &heap;
+}
+
+
+size_t Allocator::getAlignment(size_t bytes)
+{
+   return (bytes >= sLargeAllocation) ? sCacheLineSize : sMinAlignment;
+}
+
+
+// blocks are chained in allocation order, the data follows the header
+class Arena::Block
+{
+public:
+   Block* mNext;
+   size_t mSize;
+
+   unsigned char* getData()
+   {
+      return (unsigned char*)this + alignSize(sizeof(Block), sBlockAlignment);
+   }
+};
+
+
+Arena::Arena(size_t blockSize)
+ : mFirst(0)
+ , mCurrent(0)
+ , mOffset(0)
+ , mBlockSize(alignSize(blockSize > 0 ? blockSize : sMinAlignment))
+ , mLast(0)
+{
+}
+
+
+Arena::~Arena()
+{
+   Block* block= mFirst;
+   while (block)
+   {
+      Block* next= block->mNext;
+      getHeap()->release(block, alignSize(sizeof(Block), sBlockAlignment) + block->mSize);
+      block= next;
+   }
+}
+
+
+void Arena::nextBlock(size_t bytes)
+{
+   // reuse the following block from before the last reset if it is large enough
+   if (mCurrent && mCurrent->mNext && mCurrent->mNext->mSize >= bytes)
+   {
+      mCurrent= mCurrent->mNext;
+      mOffset= 0;
+      return;
+   }
+
+   const size_t size= (bytes > mBlockSize) ? bytes : mBlockSize;
+   Block* block= (Block*)getHeap()->allocate(alignSize(sizeof(Block), sBlockAlignment) + size, sBlockAlignment);
+
+   block->mSize= size;
+   mBlockSize*= 2;
+
+   // insert behind the current block, later blocks stay available
+   if (mCurrent)
+   {
+      block->mNext= mCurrent->mNext;
+      mCurrent->mNext= block;
+   }
+   else
+   {
+      block->mNext= mFirst;
+      mFirst= block;
+   }
+
+   mCurrent= block;
+   mOffset= 0;
+}
+
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+   bytes= alignSize(bytes);
+   if (alignment < sMinAlignment)
+      alignment= sMinAlignment;
+
+   size_t offset= 0;
+   if (mCurrent)
+      offset= alignSize((size_t)(mCurrent->getData() + mOffset), alignment) - (size_t)mCurrent->getData();
+
+   if (!mCurrent || offset + bytes > mCurrent->mSize)
+   {
+      // a new block starts at a cache line, larger alignments need some slack
+      const size_t slack= (alignment > sBlockAlignment) ? alignment : 0;
+      nextBlock(bytes + slack);
+      offset= alignSize((size_t)mCurrent->getData(), alignment) - (size_t)mCurrent->getData();
+   }
+
+   void* data= mCurrent->getData() + offset;
+   mOffset= offset + bytes;
+   mLast= data;
+   return data;
+}
+
+
+void* Arena::reallocate(void* data, size_t bytes, size_t newBytes, size_t alignment, size_t /*previousAlignment*/)
+{
+   if (!data)
+      return allocate(newBytes, alignment);
+
+   // the most recent allocation can simply move the end
+   if (data == mLast && isAligned(data, alignment))
+   {
+      const size_t offset= (unsigned char*)data - mCurrent->getData();
+      if (offset + alignSize(newBytes) <= mCurrent->mSize)
+      {
+         mOffset= offset + alignSize(newBytes);
+         return data;
+      }
+   }
+
+   void* result= allocate(newBytes, alignment);
+   memcpy(result, data, (bytes < newBytes) ? bytes : newBytes);
+   return result;
+}
+
+
+void Arena::release(void* data, size_t /*bytes*/)
+{
+   if (data && data == mLast)
+   {
+      mOffset= (unsigned char*)data - mCurrent->getData();
+      mLast= 0;
+   }
+}
+
+
+void Arena::reset()
+{
+   mCurrent= mFirst;
+   mOffset= 0;
+   mLast= 0;
+}
+
+
+size_t Arena::getUsed() const
+{
+   if (!mCurrent)
+      return 0;
+
+   size_t used= mOffset;
+   for (Block* block= mFirst; block != mCurrent; block= block->mNext)
+      used+= block->mSize;
+   return used;
+}
+
+
+size_t Arena::getCapacity() const
+{
+   size_t capacity= 0;
+   for (Block* block= mFirst; block; block= block->mNext)
+      capacity+= block->mSize;
+   return capacity;
+}
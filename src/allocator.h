@@ -0,0 +1,92 @@
+/*
+ memory sources for arrays
+
+ every array allocates through an Allocator, the default is the heap (malloc/realloc/free).
+ an Arena hands out memory from a few large blocks by bumping an offset. freeing single
+ allocations only works for the most recent one, everything else is dropped at once by
+ reset(), which keeps the blocks for the next round. this suits scratch data that lives
+ for one call or one loop iteration.
+
+ usage:
+ Arena arena;
+ Array<int> scratch(&arena, count);
+ ...
+ arena.reset(); // all arrays using the arena have to be gone by now
+
+ alignment:
+ allocations are aligned to at least 16 bytes. arrays ask for a cache line (64 bytes)
+ from sLargeAllocation bytes on, so SIMD loops can use aligned loads and threads working
+ on neighbouring parts of an array do not share a cache line (see getChunkBegin()).
+ an arena is not thread-safe.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+class Allocator
+{
+public:
+   static const size_t sMinAlignment= 16;
+   static const size_t sCacheLineSize= 64;
+   static const size_t sLargeAllocation= 1024;
+
+   virtual ~Allocator() {}
+
+   //! at least "bytes" of memory at a multiple of "alignment" (a power of two)
+   //! throws std::bad_alloc when out of memory
+   virtual void* allocate(size_t bytes, size_t alignment) = 0;
+
+   //! resize an allocation of "bytes" to "newBytes", keeps the content
+   //! "previousAlignment" is the alignment "data" was allocated with, it may differ from "alignment"
+   virtual void* reallocate(void* data, size_t bytes, size_t newBytes, size_t alignment, size_t previousAlignment) = 0;
+
+   //! free an allocation of "bytes"
+   virtual void release(void* data, size_t bytes) = 0;
+
+   //! malloc/realloc/free (aligned variants), shared by all threads
+   static Allocator* getHeap();
+
+   //! alignment arrays use for an allocation of the given size
+   static size_t getAlignment(size_t bytes);
+};
+
+
+class Arena : public Allocator
+{
+public:
+   //! size of the first block, later blocks double in size (or fit a larger request)
+   explicit Arena(size_t blockSize= 64 * 1024);
+   virtual ~Arena();
+
+   Arena(const Arena&) = delete;
+   Arena& operator = (const Arena&) = delete;
+
+   virtual void* allocate(size_t bytes, size_t alignment);
+
+   //! grows in place if "data" is the most recent allocation and the block has room
+   virtual void* reallocate(void* data, size_t bytes, size_t newBytes, size_t alignment, size_t previousAlignment);
+
+   //! only the most recent allocation is given back, others stay until reset()
+   virtual void release(void* data, size_t bytes);
+
+   //! drop all allocations in O(1), the blocks are kept
+   void reset();
+
+   //! bytes handed out since the last reset(), including the unused ends of filled blocks
+   size_t getUsed() const;
+
+   //! bytes of all blocks
+   size_t getCapacity() const;
+
+private:
+   class Block;
+
+   void nextBlock(size_t bytes);
+
+   Block* mFirst;
+   Block* mCurrent;
+   size_t mOffset;      //!< used bytes of mCurrent
+   size_t mBlockSize;   //!< size of the next new block
+   void*  mLast;        //!< most recent allocation (0: none)
+};
@@ -9,31 +9,298 @@
  array.init(...) with the number of items required
  array.add(...) items
  array.get(..) item from the array
+
+ raw data:
+ setRawData() references memory the array does not own (e.g. a mapped file).
+ it is modified in place and never deleted, growing the array moves it to own memory.
+
+ ownership transfer:
+ moving an array hands its data over without copying and leaves the source empty.
+
+ threads:
+ the reference counting base class is a template parameter. the default Referenced
+ is single threaded, Array<Item, AtomicReferenced> may share its data with arrays
+ used by other threads. as with any container a single array object must not be
+ modified by several threads at once.
+
+ storage layout:
+ the reference counter is kept in a small header directly in front of the items, so
+ owned data and counter share one allocation. empty arrays allocate nothing,
+ raw data gets a separate counter.
+
+ allocators:
+ storage comes from an Allocator, the heap unless another one (e.g. an Arena) is given
+ on construction or by setAllocator(). references share the allocator of their data.
+
+ alignment and padding:
+ large arrays start at a cache line (see Allocator::getAlignment()). setPadding(n) rounds
+ every later allocation up to a multiple of n items, loops working on n items at a time
+ may then run past size() up to capacity() without a remainder loop.
+ padding items are not initialized for trivially copyable types.
+
+ statistics:
+ with ARRAY_STATISTICS defined allocations, growth and copies on write are counted
+ per tag, see arraystatistics.h. setTag() names the allocations of an array.
+
+ trivially copyable items:
+ storage is not constructed (unless the type has a non-trivial default constructor),
+ copies are done with memcpy() and growing owned data uses Allocator::reallocate().
+ other types are constructed and destroyed in place and copied item by item.
 */
 
 #pragma once
 
+#include "allocator.h"
+#include "arraystatistics.h"
 #include "referenced.h"
 #include <memory.h>
+#include <new>
+#include <type_traits>
+
+#ifdef ARRAY_STATISTICS
+#define ARRAY_RECORD(event, bytes) ArrayStatistics::record(mTag, ArrayStatistics::event, bytes)
+#else
+#define ARRAY_RECORD(event, bytes)
+#endif
+
+//! alignment of "count" items: a cache line for large arrays, never less than the item needs
+template <class Item> inline size_t getArrayAlignment(int count)
+{
+   const size_t alignment= Allocator::getAlignment((size_t)count * sizeof(Item));
+   return (alignof(Item) > alignment) ? alignof(Item) : alignment;
+}
+
+//! allocation of "capacity" items behind a header, items are neither constructed nor destroyed
+template <class Item> class ArrayBlock
+{
+public:
+   //! bytes in front of the items, keeps them aligned and leaves room for a counter
+   static size_t getHeaderSize(int capacity)
+   {
+      return getArrayAlignment<Item>(capacity);
+   }
+
+   static Item* allocate(Allocator* allocator, int capacity)
+   {
+      const size_t header= getHeaderSize(capacity);
+      char* block= (char*)allocator->allocate(header + (size_t)capacity * sizeof(Item), getArrayAlignment<Item>(capacity));
+      return (Item*)(block + header);
+   }
+
+   static void release(Allocator* allocator, Item* items, int capacity)
+   {
+      const size_t header= getHeaderSize(capacity);
+      allocator->release((char*)items - header, header + (size_t)capacity * sizeof(Item));
+   }
+
+   //! keeps the first "count" items, they move if the header size changes
+   static Item* reallocate(Allocator* allocator, Item* items, int count, int capacity, int newCapacity)
+   {
+      const size_t header= getHeaderSize(capacity);
+      const size_t newHeader= getHeaderSize(newCapacity);
+      const size_t bytes= (size_t)((count < newCapacity) ? count : newCapacity) * sizeof(Item);
+      char* block= (char*)items - header;
+
+      if (newHeader < header)
+         memmove(block + newHeader, items, bytes);
+
+      block= (char*)allocator->reallocate(
+         block,
+         header + (size_t)capacity * sizeof(Item),
+         newHeader + (size_t)newCapacity * sizeof(Item),
+         getArrayAlignment<Item>(newCapacity),
+         getArrayAlignment<Item>(capacity)
+      );
+
+      if (newHeader > header)
+         memmove(block + newHeader, block + header, bytes);
+
+      return (Item*)(block + newHeader);
+   }
+};
+
+//! allocation and copying of array items, specialized for trivially copyable types
+template <class Item, bool trivial= std::is_trivially_copyable<Item>::value>
+class ArrayStorage
+{
+   typedef ArrayBlock<Item> Block;
+
+public:
+   static size_t getHeaderSize(int capacity)
+   {
+      return Block::getHeaderSize(capacity);
+   }
+
+   static Item* allocate(Allocator* allocator, int count)
+   {
+      if (count <= 0)
+         return 0;
+
+      Item* items= Block::allocate(allocator, count);
+      for (int i=0; i<count; i++)
+         new (&items[i]) Item;
+      return items;
+   }
+
+   //! destroy all "capacity" items and free the storage
+   static void release(Allocator* allocator, Item* items, int capacity)
+   {
+      if (!items)
+         return;
+
+      for (int i=0; i<capacity; i++)
+         items[i].~Item();
+      Block::release(allocator, items, capacity);
+   }
+
+   static void copy(Item* dst, const Item* src, int count)
+   {
+      for (int i=0; i<count; i++)
+         dst[i]= src[i];
+   }
+
+   //! copy between overlapping ranges
+   static void move(Item* dst, const Item* src, int count)
+   {
+      if (dst < src)
+      {
+         for (int i=0; i<count; i++)
+            dst[i]= src[i];
+      }
+      else
+      {
+         for (int i=count-1; i>=0; i--)
+            dst[i]= src[i];
+      }
+   }
+
+   //! resize owned storage from "capacity" to "newCapacity" keeping the first "count" items
+   static Item* reallocate(Allocator* allocator, Item* items, int count, int capacity, int newCapacity)
+   {
+      Item* result= allocate(allocator, newCapacity);
+      copy(result, items, (count < newCapacity) ? count : newCapacity);
+      release(allocator, items, capacity);
+      return result;
+   }
+};
 
 template <class Item>
-class Array : public Referenced
+class ArrayStorage<Item, true>
+{
+   typedef ArrayBlock<Item> Block;
+
+public:
+   static size_t getHeaderSize(int capacity)
+   {
+      return Block::getHeaderSize(capacity);
+   }
+
+   static Item* allocate(Allocator* allocator, int count)
+   {
+      if (count <= 0)
+         return 0;
+
+      Item* items= Block::allocate(allocator, count);
+      construct(items, 0, count);
+      return items;
+   }
+
+   static void release(Allocator* allocator, Item* items, int capacity)
+   {
+      if (items)
+         Block::release(allocator, items, capacity);
+   }
+
+   static void copy(Item* dst, const Item* src, int count)
+   {
+      if (count > 0)
+         memcpy(dst, src, (size_t)count * sizeof(Item));
+   }
+
+   static void move(Item* dst, const Item* src, int count)
+   {
+      if (count > 0)
+         memmove(dst, src, (size_t)count * sizeof(Item));
+   }
+
+   static Item* reallocate(Allocator* allocator, Item* items, int count, int capacity, int newCapacity)
+   {
+      if (newCapacity <= 0)
+      {
+         release(allocator, items, capacity);
+         return 0;
+      }
+
+      Item* result= Block::reallocate(allocator, items, count, capacity, newCapacity);
+      construct(result, capacity, newCapacity);
+      return result;
+   }
+
+private:
+   // only types with a user provided default constructor need it to run
+   static void construct(Item* items, int begin, int end)
+   {
+      if (!std::is_trivially_default_constructible<Item>::value)
+      {
+         for (int i=begin; i<end; i++)
+            new (&items[i]) Item;
+      }
+   }
+};
+
+template <class Item, class References= Referenced>
+class Array : public References
 {
 public:
+   using References::addRef;
+   using References::deref;
+   using References::copyRef;
+   using References::getRefCount;
+   using References::getRef;
+
    //! construct empty array with given size (default: zero size, null pointer)
   Array(int size = 0, bool fill = false);
 
+  //! construct empty array allocating from "allocator", which has to outlive the data
+  explicit Array(Allocator* allocator, int size = 0, bool fill = false);
+
   //! construct reference of given array "a"
   Array(const Array& a);
 
+  //! take over the data of "a", "a" is left empty
+  Array(Array&& a);
+
   //! construct new array from given items and count
   Array(Item* items, int count);
 
+  //! reference "count" items at "items" without copying, the memory is not owned by the array
+  //! and has to outlive it and all its references
+  void setRawData(Item* items, int count);
+
+  //! array references memory it does not own
+  bool isRawData() const;
+
+  //! allocate from "allocator" from now on, owned data is copied over
+  void setAllocator(Allocator* allocator);
+  Allocator* getAllocator() const;
+
+  //! round the capacity of following allocations up to a multiple of "items"
+  void setPadding(int items);
+  int getPadding() const;
+
+  //! count allocations under "tag" (a string literal), only with ARRAY_STATISTICS
+  //! copies of the array take the tag over, assignments keep their own
+  void setTag(const char* tag);
+  const char* getTag() const;
+
   // delete the array
   virtual ~Array();
 
   //! assignment operator: reference given array
-  Array<Item>& operator = (const Array<Item>& list);
+  Array& operator = (const Array& list);
+
+  //! move assignment: take over the data of "list", "list" is left empty
+  Array& operator = (Array&& list);
 
   // initialize array to given size
   // existing data will be deallocated
@@ -60,7 +327,7 @@ public:
   int add(const Item& item);
 
   // add list
-  int add(const Array<Item>& data);
+  int add(const Array& data);
 
   // get last element of array
   const Item& getLast() const;
@@ -81,7 +348,7 @@ public:
   void insert(int index, const Item& item);
 
   // create a copy of given array "a"
-  void copy(const Array<Item>& a);
+  void copy(const Array& a);
 
   // remove all occurances of the given item. following items will be moved
   // non-pointer types need "==" operator
@@ -99,235 +366,353 @@ public:
   // return number of items currently in the array
   int capacity() const;
 
+  // heap bytes held by the array including the header (0 for raw data),
+  // shared data is counted by every reference
+  long long getMemoryUsage() const;
+
+  // bytes an owned array of the given capacity takes
+  static long long estimateMemoryUsage(int capacity);
+
 private:
-  // create a deep copy of given data
-  void deepCopy(const Array<Item>& a);
+  typedef typename References::Counter Counter;
+
+  // copy shared or raw data to own storage of given capacity
+  // "previous" is the allocator of the current data if it was changed meanwhile
+  void detach(int capacity, Allocator* previous= 0);
   void grow();
 
+  // add() when the data is shared or full, kept out of the inlined part
+  int addDetached(const Item& item);
+
+  // move unshared data to owned storage of given capacity
+  void reallocate(int capacity);
+
+  // start counting references to the current data (none for empty arrays)
+  void attach();
+
+  // drop the reference to the current data, the last reference frees it
+  void release(Allocator* allocator);
+
+  // capacity rounded up to the padding
+  int getPaddedSize(int size) const;
+
+  typedef ArrayStorage<Item> Storage;
+
 protected:
-   Item *mData; // array of items
-   int  mSize;  // size of array
-   int  mCount; // number of items in array
+   using References::mReferences;
+
+   Item *mData;    // array of items
+   int  mSize;     // size of array
+   int  mCount;    // number of items in array
+   bool mRawData;  // mData is not owned by the array (never deleted)
+   Allocator* mAllocator;  // source of mData
+   int  mPadding;  // capacity is a multiple of this
+#ifdef ARRAY_STATISTICS
+   const char* mTag = 0;  // statistics of this array are counted under it
+#endif
 };
 
 //! construct empty array
-template <class Item> Array<Item>::Array(int size, bool fill)
-: Referenced()
+template <class Item, class References> Array<Item, References>::Array(int size, bool fill)
+: References()
+, mData(0)
+, mSize(size)
+, mCount(0)
+, mRawData(false)
+, mAllocator(Allocator::getHeap())
+, mPadding(1)
+{
+   if (mSize>0)
+   {
+      mData= Storage::allocate(mAllocator, mSize);
+      attach();
+      ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
+      if (fill)
+         mCount= mSize;
+   }
+}
+
+//! construct empty array using the given allocator
+template <class Item, class References> Array<Item, References>::Array(Allocator* allocator, int size, bool fill)
+: References()
 , mData(0)
 , mSize(size)
 , mCount(0)
+, mRawData(false)
+, mAllocator(allocator)
+, mPadding(1)
 {
    if (mSize>0)
    {
-      mData= new Item[mSize];
+      mData= Storage::allocate(mAllocator, mSize);
+      attach();
+      ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
       if (fill)
          mCount= mSize;
    }
 }
 
 //! construct reference of given array "a"
-template <class Item> Array<Item>::Array(const Array& a)
-: Referenced(a)
+template <class Item, class References> Array<Item, References>::Array(const Array& a)
+: References(a)
 {
    mData= a.data();
    mSize= a.capacity();
    mCount= a.size();
+   mRawData= a.isRawData();
+   mAllocator= a.getAllocator();
+   mPadding= a.getPadding();
+#ifdef ARRAY_STATISTICS
+   mTag= a.mTag;
+#endif
+}
+
+//! take over data and reference counter of "a"
+template <class Item, class References> Array<Item, References>::Array(Array&& a)
+: References()
+, mData(a.mData)
+, mSize(a.mSize)
+, mCount(a.mCount)
+, mRawData(a.mRawData)
+, mAllocator(a.mAllocator)
+, mPadding(a.mPadding)
+{
+   mReferences= a.mReferences;
+   a.mReferences= 0;
+#ifdef ARRAY_STATISTICS
+   mTag= a.mTag;
+#endif
+
+   a.mData= 0;
+   a.mSize= 0;
+   a.mCount= 0;
+   a.mRawData= false;
 }
 
 //! construct array with given items and count
-template <class Item> Array<Item>::Array(Item* items, int count)
-: Referenced()
+template <class Item, class References> Array<Item, References>::Array(Item* items, int count)
+: References()
 , mData(0)
 , mSize(count)
 , mCount(count)
+, mRawData(false)
+, mAllocator(Allocator::getHeap())
+, mPadding(1)
 {
    if (count>0)
    {
-      mData= new Item[count];
-      for (int i=0;i<count;i++)
-         mData[i]= items[i];
+      mData= Storage::allocate(mAllocator, count);
+      Storage::copy(mData, items, count);
+      attach();
+      ARRAY_RECORD(Allocation, estimateMemoryUsage(count));
    }
 }
 
 //! destructor: delete array if no more references
-template <class Item> Array<Item>::~Array()
+template <class Item, class References> Array<Item, References>::~Array()
 {
-   if (getRefCount()==1)
-   {
-      if (mData) delete[] mData;
-   }
+   // last reference: delete data and reference counter
+   release(mAllocator);
 }
 
 //! assignment operator: create reference of given array
-template <class Item> Array<Item>& Array<Item>::operator = (const Array<Item>& list)
+template <class Item, class References> Array<Item, References>& Array<Item, References>::operator = (const Array& list)
 {
    if (this != &list)
    {
-      // array is not referenced: delete data and reference counter
-      if (getRefCount() == 1)
-      {
-         if (mData)
-            delete[] mData;
-         delete mReferences;
-      }
+      // reference the new data first, "list" may share the counter
+      list.addRef();
+
+      // array is not referenced anymore: delete data and reference counter
+      release(mAllocator);
 
       mReferences= list.getRef();
-      addRef();
       mSize= list.capacity();
       mCount= list.size();
       mData= list.data();
+      mRawData= list.isRawData();
+      mAllocator= list.getAllocator();
+      mPadding= list.getPadding();
+#ifdef ARRAY_STATISTICS
+      mTag= list.mTag;
+#endif
    }
    return *this;
 }
 
-//! init array with given size
-template <class Item> void Array<Item>::init(int size, bool fill)
+//! move assignment: take over data and reference counter of "list"
+template <class Item, class References> Array<Item, References>& Array<Item, References>::operator = (Array&& list)
 {
-   // data is not referenced by another object? delete it.
-   if (!copyRef())
+   if (this != &list)
    {
-      if (mData)
-         delete[] mData;
+      release(mAllocator);
+
+      mReferences= list.mReferences;
+      list.mReferences= 0;
+
+      mData= list.mData;
+      mSize= list.mSize;
+      mCount= list.mCount;
+      mRawData= list.mRawData;
+      mAllocator= list.mAllocator;
+      mPadding= list.mPadding;
+#ifdef ARRAY_STATISTICS
+      mTag= list.mTag;
+#endif
+
+      list.mData= 0;
+      list.mSize= 0;
+      list.mCount= 0;
+      list.mRawData= false;
    }
+   return *this;
+}
 
-   if (size>0)
-      mData= new Item[size];
-   else
-      mData= 0;
-   mSize= size;
+//! init array with given size
+template <class Item, class References> void Array<Item, References>::init(int size, bool fill)
+{
+   // data is not referenced by another object? delete it.
+   release(mAllocator);
+
+   mSize= getPaddedSize(size);
+   mData= Storage::allocate(mAllocator, mSize);
+   mRawData= false;
+   attach();
+   ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
    if (fill)
-      mCount= mSize;
+      mCount= size;
    else
       mCount= 0;
 }
 
 //! resize array to given size
-template <class Item> void Array<Item>::resize(int size)
+template <class Item, class References> void Array<Item, References>::resize(int size)
 {
-   // data is not referenced by another object? delete it.
-   bool isCopy= copyRef();
-   Item* temp= mData;
+   size= getPaddedSize((size < 0) ? 0 : size);
 
-   if (size>0)
+   // data is not referenced by another object? resize it in place.
+   if (getRefCount() > 1 || mRawData || !mData)
    {
-      mSize= size;
-      mData= new Item[size];
-      if (mCount > mSize)
-         mCount= mSize;
-      for (int i=0; i<mCount; i++)
-      {
-         mData[i]= temp[i];
-      }
+      detach(size);
    }
    else
    {
-      mData= 0;
-      mSize= 0;
-      mCount= 0;
+      if (mCount > size)
+         mCount= size;
+      mData= Storage::reallocate(mAllocator, mData, mCount, mSize, size);
+      mSize= size;
+      attach();
+      ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
    }
-
-   if (!isCopy)
-      delete[] temp;
 }
 
 
 //! clear array
-template <class Item> void Array<Item>::clear()
+template <class Item, class References> void Array<Item, References>::clear()
 {
-   if (copyRef())
-      mData= new Item[mSize];
    mCount= 0;
+   if (getRefCount() > 1)
+      detach(mSize);
 }
 
 //! get item from array at given "index"
-template <class Item> const Item& Array<Item>::get(int index) const
+template <class Item, class References> const Item& Array<Item, References>::get(int index) const
 {
    return mData[index];
 }
 
 
 //! get and remove last item
-template <class Item> const Item& Array<Item>::getLast() const
+template <class Item, class References> const Item& Array<Item, References>::getLast() const
 {
    return mData[mCount-1];
 }
 
 
 //! get and remove last item
-template <class Item> const Item& Array<Item>::takeLast()
+template <class Item, class References> const Item& Array<Item, References>::takeLast()
 {
    mCount--;
    return mData[mCount];
 }
 
 // grow array size
-template <class Item> void Array<Item>::grow()
+template <class Item, class References> void Array<Item, References>::grow()
 {
    // grow array when more elements are needed
-   Item *temp= mData;
-   if (!mSize)
-      mSize= 16; // initial minimum size is 16
-   else
-      mSize<<=1;
+   reallocate(getPaddedSize(mSize ? (mSize << 1) : 16)); // initial minimum size is 16
+}
 
-   mData= new Item[mSize];
-   if (temp)
+// resize data nobody else references, raw data is copied
+template <class Item, class References> void Array<Item, References>::reallocate(int capacity)
+{
+   if (mData && !mRawData)
+   {
+      mData= Storage::reallocate(mAllocator, mData, mCount, mSize, capacity);
+   }
+   else
    {
-      for (int i=0;i<mCount;i++) mData[i]= temp[i];
-      delete[] temp;
+      Item *items= Storage::allocate(mAllocator, capacity);
+      Storage::copy(items, mData, mCount);
+      release(mAllocator);
+      mData= items;
    }
+
+   mSize= capacity;
+   mRawData= false;
+   attach();
+   ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
+   ARRAY_RECORD(Grow, 0);
 }
 
 //! add item at the end of the array
-template <class Item> int Array<Item>::add(const Item& item)
+template <class Item, class References> inline int Array<Item, References>::add(const Item& item)
 {
-   if (copyRef())
-      deepCopy(*this);
+   if (mCount>=mSize || getRefCount() > 1)
+      return addDetached(item);
+
+   mData[mCount]= item;
+   return mCount++;
+}
+
+template <class Item, class References> int Array<Item, References>::addDetached(const Item& item)
+{
+   // "item" may be stored in this array
+   const Item value= item;
+
+   // when detaching we quite certainly want to add more items
+   if (getRefCount() > 1)
+      detach(mCount ? mCount : 16);
 
    if (mCount>=mSize)
-   {
       grow();
-   }
 
-   int index= mCount;
-   mData[mCount]= item;
-   mCount++;
-   return index;
+   mData[mCount]= value;
+   return mCount++;
 }
 
 
 //! add content of other array
-template <class Item> int Array<Item>::add(const Array<Item>& data)
+template <class Item, class References> int Array<Item, References>::add(const Array& data)
 {
-   if (copyRef())
-      deepCopy(*this);
-   else
-   {
-      // grow array when more elements are needed
-      if (mCount + data.size() >= mSize)
-      {
-         Item *temp= mData;
-         mSize= mCount + data.size();
-         mData= new Item[mSize];
-         if (temp)
-         {
-            for (int i=0; i<mCount; i++)
-               mData[i]= temp[i];
-            delete[] temp;
-         }
-      }
-   }
+   const int count= data.size();
 
-   for (int i=0; i<data.size(); i++)
-      mData[mCount+i]= data[i];
+   if (getRefCount() > 1)
+      detach(mCount + count);
 
-   mCount+= data.size();
+   // grow array when more elements are needed
+   if (mCount + count > mSize)
+      reallocate(getPaddedSize(mCount + count));
+
+   // "data" may be this array
+   Storage::copy(mData + mCount, data.data(), count);
+   mCount+= count;
 
    return -1;
 }
 
 //! return index of element (-1 if not existing)
-template <class Item> int Array<Item>::indexOf(const Item& item) const
+template <class Item, class References> int Array<Item, References>::indexOf(const Item& item) const
 {
    for (int index=0; index<mCount; index++)
    {
@@ -338,7 +723,7 @@ template <class Item> int Array<Item>::indexOf(const Item& item) const
 }
 
 //! return whether given element is in the list
-template <class Item> bool Array<Item>::contains(const Item& item) const
+template <class Item, class References> bool Array<Item, References>::contains(const Item& item) const
 {
    for (int index=0; index<mCount; index++)
    {
@@ -349,118 +734,71 @@ template <class Item> bool Array<Item>::contains(const Item& item) const
 }
 
 //! remove element at "index"
-template <class Item> void Array<Item>::removeAt(int index)
+template <class Item, class References> void Array<Item, References>::removeAt(int index)
 {
-   if (copyRef())
-   {
-      //! create new array without element at index
-      Item *temp= mData;
-      mData= new Item[mSize];
-      for (int i=0;i<index;i++)
-         mData[i]= temp[i];
-      for (int i=index;i<mCount-1;i++)
-         mData[i]= temp[i+1];
-   }
-   else
-   {
-      // copy in-place
-      for (int i=index;i<mCount-1;i++)
-         mData[i]= mData[i+1];
-   }
+   if (getRefCount() > 1)
+      detach(mSize);
 
+   // copy in-place
+   Storage::move(mData + index, mData + index + 1, mCount - index - 1);
    mCount--;
 }
 
 //! insert item at given index
-template <class Item> void Array<Item>::insert(int index, const Item& item)
+template <class Item, class References> void Array<Item, References>::insert(int index, const Item& item)
 {
-   if (!copyRef())
-   {
-      // copy in-place possible?
-      if (mSize>mCount)
-      {
-         // move elements after index
-         for (int i=mCount-1;i>=index;i--)
-            mData[i+1]= mData[i];
-         mData[index]= item;
-         mCount++;
-         return;
-      }
-   }
+   // "item" may be stored in this array
+   const Item value= item;
 
-   Item *temp= mData;
+   if (getRefCount() > 1)
+      detach(mSize);
 
    // needs resize?
    if (mCount==mSize)
-      mSize<<=1;
-
-   // create new array
-   mData= new Item[mSize];
-
-   // copy first half
-   for (int i=0;i<index;i++)
-      mData[i]= temp[i];
-   mData[index]= item;
-   // copy second half
-   for (int i=index;i<mCount;i++)
-      mData[i+1]= temp[i];
+      grow();
 
+   // move elements after index
+   Storage::move(mData + index + 1, mData + index, mCount - index);
+   mData[index]= value;
    mCount++;
 }
 
 //! create a copy of the given array "a"
-template <class Item> void Array<Item>::copy(const Array<Item>& a)
+template <class Item, class References> void Array<Item, References>::copy(const Array& a)
 {
-   if (!copyRef())
-   {
-      if (mData)
-         delete[] mData;
-   }
-
-   mCount= mSize= a.size();
-   if (mCount > 0)
-   {
-      mData= new Item[mCount];
-      for (int i=0;i<mCount;i++)
-         mData[i]= a[i];
-   }
-   else
-      mData= 0;
+   // copy first, "a" may reference the data of this array
+   const int count= a.size();
+   Item* items= Storage::allocate(mAllocator, getPaddedSize(count));
+   Storage::copy(items, a.data(), count);
+
+   release(mAllocator);
+
+   mRawData= false;
+   mCount= count;
+   mSize= getPaddedSize(count);
+   mData= items;
+   attach();
+   ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
 }
 
 //! remove all occurences of "item" from the array
 //! returns true if items were removed
-template <class Item> int Array<Item>::remove(const Item& item)
+template <class Item, class References> int Array<Item, References>::remove(const Item& item)
 {
    int src=0;
    int pos= 0;
 
-   if (copyRef())
-   {
-      //! create new array without given element
-      Item *temp= mData;
-      mData= new Item[mSize];
+   if (getRefCount() > 1)
+      detach(mSize);
 
-      for (src=0; src<mCount; src++)
-      {
-         if (temp[src] != item)
-         {
-            mData[pos]= temp[src];
-            pos++;
-         }
-      }
-   }
-   else
+   // copy in-place
+   for (src=0; src<mCount; src++)
    {
-      // copy in-place
-      for (src=0; src<mCount; src++)
+      if (mData[src] != item)
       {
-         if (mData[src] != item)
-         {
-            if (pos != src) // avoid temp[pos]= temp[pos]
-               mData[pos]= mData[src];
-            pos++;
-         }
+         if (pos != src) // avoid temp[pos]= temp[pos]
+            mData[pos]= mData[src];
+         pos++;
       }
    }
 
@@ -469,41 +807,166 @@ template <class Item> int Array<Item>::remove(const Item& item)
    return count;
 }
 
+//! reference external memory
+template <class Item, class References> void Array<Item, References>::setRawData(Item* items, int count)
+{
+   // data is not referenced by another object? delete it.
+   release(mAllocator);
+
+   mData= items;
+   mSize= count;
+   mCount= count;
+   mRawData= true;
+   attach();
+}
+
+template <class Item, class References> bool Array<Item, References>::isRawData() const
+{
+   return mRawData;
+}
+
+//! switch the allocator, owned data is moved to it
+template <class Item, class References> void Array<Item, References>::setAllocator(Allocator* allocator)
+{
+   if (allocator == mAllocator)
+      return;
+
+   if (mData && !mRawData)
+   {
+      Allocator* previous= mAllocator;
+      mAllocator= allocator;
+      detach(mSize, previous);
+   }
+   else
+   {
+      mAllocator= allocator;
+   }
+}
+
+template <class Item, class References> Allocator* Array<Item, References>::getAllocator() const
+{
+   return mAllocator;
+}
+
+//! capacity multiple for following allocations
+template <class Item, class References> void Array<Item, References>::setPadding(int items)
+{
+   mPadding= (items > 1) ? items : 1;
+}
+
+template <class Item, class References> int Array<Item, References>::getPadding() const
+{
+   return mPadding;
+}
+
+template <class Item, class References> int Array<Item, References>::getPaddedSize(int size) const
+{
+   return (size + mPadding - 1) / mPadding * mPadding;
+}
+
+//! name for the statistics, ignored without them
+template <class Item, class References> void Array<Item, References>::setTag(const char* tag)
+{
+#ifdef ARRAY_STATISTICS
+   mTag= tag;
+#else
+   (void)tag;
+#endif
+}
+
+template <class Item, class References> const char* Array<Item, References>::getTag() const
+{
+#ifdef ARRAY_STATISTICS
+   return mTag;
+#else
+   return 0;
+#endif
+}
+
 //! return pointer to array-data
-template <class Item> Item* Array<Item>::data() const
+template <class Item, class References> Item* Array<Item, References>::data() const
 {
    return mData;
 }
 
 // return number of items in the array
-template <class Item> int Array<Item>::size() const
+template <class Item, class References> int Array<Item, References>::size() const
 {
    return mCount;
 }
 
-template <class Item> bool Array<Item>::isEmpty() const
+template <class Item, class References> bool Array<Item, References>::isEmpty() const
 {
    return (mCount == 0);
 }
 
 // return number of items the array can hold without reallocating
-template <class Item> int Array<Item>::capacity() const
+template <class Item, class References> int Array<Item, References>::capacity() const
 {
    return mSize;
 }
 
-//! create a deep copy of the given array
-template <class Item> void Array<Item>::deepCopy(const Array<Item>& a)
+// heap bytes held by the array
+template <class Item, class References> long long Array<Item, References>::getMemoryUsage() const
 {
-   Item *temp= a.data();
-   mCount= a.size();
-   mSize= mCount;
+   return mRawData ? 0 : estimateMemoryUsage(mSize);
+}
+
+template <class Item, class References> long long Array<Item, References>::estimateMemoryUsage(int capacity)
+{
+   if (capacity <= 0)
+      return 0;
+
+   return (long long)capacity * sizeof(Item) + Storage::getHeaderSize(capacity);
+}
+
+//! copy the data to own storage, the old data is released afterwards
+//! (with atomic counters the other references may have been dropped meanwhile)
+template <class Item, class References> void Array<Item, References>::detach(int capacity, Allocator* previous)
+{
+   if (mCount > capacity)
+      mCount= capacity;
+
+#ifdef ARRAY_STATISTICS
+   if (mData && (mRawData || getRefCount() > 1))
+      ArrayStatistics::record(mTag, ArrayStatistics::Copy, (long long)mCount * sizeof(Item));
+#endif
+
+   const int size= getPaddedSize(capacity);
+   Item *items= Storage::allocate(mAllocator, size);
+   Storage::copy(items, mData, mCount);
+
+   release(previous ? previous : mAllocator);
 
-   // when doing a deep copy we quite certainly want to add an item:
-   if (mSize==0)
-      mSize= 16;
-   mData= new Item[mSize];
-   for (int i=0;i<mCount;i++)
-      mData[i]= temp[i];
+   mData= items;
+   mSize= size;
+   mRawData= false;
+   attach();
+   ARRAY_RECORD(Allocation, estimateMemoryUsage(mSize));
+}
+
+//! the counter of owned data is placed right in front of the items
+template <class Item, class References> void Array<Item, References>::attach()
+{
+   if (!mData)
+      References::setRef(0);
+   else if (mRawData)
+      References::setRef(new Counter(1));
+   else
+      References::setRef(new ((Counter*)mData - 1) Counter(1));
+}
+
+//! the last reference deletes the data, the counter goes with it
+template <class Item, class References> void Array<Item, References>::release(Allocator* allocator)
+{
+   if (!deref())
+   {
+      if (mRawData)
+         delete mReferences;
+      else
+         Storage::release(allocator, mData, mSize);
+   }
+   References::setRef(0);
 }
 
+#undef ARRAY_RECORD
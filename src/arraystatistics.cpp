@@ -0,0 +1,152 @@
+#include "arraystatistics.h"
+
+#ifdef ARRAY_STATISTICS
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+class TagCounters
+{
+public:
+   long long mAllocations= 0;
+   long long mBytes= 0;
+   long long mGrows= 0;
+   long long mCopies= 0;
+   long long mCopiedBytes= 0;
+};
+
+class StatisticsRegistry
+{
+public:
+   std::mutex mMutex;
+   std::map<std::string, TagCounters> mTags;
+};
+
+static thread_local const char* sScopeTag= 0;
+
+
+static void reportAtExit()
+{
+   ArrayStatistics::report();
+}
+
+
+static StatisticsRegistry* createRegistry()
+{
+   atexit(reportAtExit);
+   return new StatisticsRegistry();
+}
+
+
+// never deleted, arrays may still be released by static destructors
+static StatisticsRegistry* getRegistry()
+{
+   static StatisticsRegistry* registry= createRegistry();
+   return registry;
+}
+
+
+ArrayStatistics::Scope::Scope(const char* tag)
+ : mPrevious(sScopeTag)
+{
+   sScopeTag= tag;
+}
+
+
+ArrayStatistics::Scope::~Scope()
+{
+   sScopeTag= mPrevious;
+}
+
+
+void ArrayStatistics::record(const char* tag, Event event, long long bytes)
+{
+   if (event == Allocation && bytes <= 0)
+      return;
+
+   if (!tag)
+      tag= sScopeTag ? sScopeTag : "untagged";
+
+   StatisticsRegistry* registry= getRegistry();
+   std::lock_guard<std::mutex> lock(registry->mMutex);
+   TagCounters& counters= registry->mTags[tag];
+
+   switch (event)
+   {
+      case Allocation:
+         counters.mAllocations++;
+         counters.mBytes+= bytes;
+         break;
+
+      case Grow:
+         counters.mGrows++;
+         break;
+
+      case Copy:
+         counters.mCopies++;
+         counters.mCopiedBytes+= bytes;
+         break;
+   }
+}
+
+
+void ArrayStatistics::report(FILE* file)
+{
+   StatisticsRegistry* registry= getRegistry();
+   std::lock_guard<std::mutex> lock(registry->mMutex);
+
+   std::vector<std::pair<std::string, TagCounters> > tags(registry->mTags.begin(), registry->mTags.end());
+   std::sort(tags.begin(), tags.end(), [](const std::pair<std::string, TagCounters>& a, const std::pair<std::string, TagCounters>& b)
+   {
+      return a.second.mBytes > b.second.mBytes;
+   });
+
+   TagCounters total;
+   fprintf(file, "array statistics:\n");
+   fprintf(file, "%-24s %12s %14s %10s %10s %14s\n", "tag", "allocations", "bytes", "grows", "copies", "copied bytes");
+   for (const auto& tag : tags)
+   {
+      const TagCounters& c= tag.second;
+      fprintf(file, "%-24s %12lld %14lld %10lld %10lld %14lld\n",
+         tag.first.c_str(), c.mAllocations, c.mBytes, c.mGrows, c.mCopies, c.mCopiedBytes);
+
+      total.mAllocations+= c.mAllocations;
+      total.mBytes+= c.mBytes;
+      total.mGrows+= c.mGrows;
+      total.mCopies+= c.mCopies;
+      total.mCopiedBytes+= c.mCopiedBytes;
+   }
+   fprintf(file, "%-24s %12lld %14lld %10lld %10lld %14lld\n",
+      "total", total.mAllocations, total.mBytes, total.mGrows, total.mCopies, total.mCopiedBytes);
+}
+
+
+void ArrayStatistics::reset()
+{
+   StatisticsRegistry* registry= getRegistry();
+   std::lock_guard<std::mutex> lock(registry->mMutex);
+   registry->mTags.clear();
+}
+
+#else
+
+void ArrayStatistics::record(const char* /*tag*/, Event /*event*/, long long /*bytes*/)
+{
+}
+
+
+void ArrayStatistics::report(FILE* file)
+{
+   fprintf(file, "array statistics: not compiled in (define ARRAY_STATISTICS)\n");
+}
+
+
+void ArrayStatistics::reset()
+{
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ allocation statistics of Array, compiled in when ARRAY_STATISTICS is defined
+ (DEFINES += ARRAY_STATISTICS in subsurf.pro). without it nothing is recorded,
+ arrays carry no tag and scopes are empty.
+
+ counted per tag:
+   allocations    storage allocated or reallocated by an array
+   bytes          size of these allocations, headers included
+   grows          reallocations because items were added beyond the capacity
+   copies         shared or raw data copied on write (detach)
+   copied bytes   item bytes copied on write
+
+ an allocation is counted under the tag of the array (Array::setTag()), else under
+ the innermost Scope of the calling thread, else as "untagged". tags have to be string
+ literals or live as long as the program. worker threads of parallelFor() start
+ without a scope.
+
+ the statistics are printed to stderr at exit, report() prints them on demand.
+*/
+
+#pragma once
+
+#include <stdio.h>
+
+class ArrayStatistics
+{
+public:
+   enum Event
+   {
+      Allocation,
+      Grow,
+      Copy
+   };
+
+   //! counts allocations of untagged arrays under "tag" while it exists
+   class Scope
+   {
+   public:
+      explicit Scope(const char* tag);
+      ~Scope();
+
+      Scope(const Scope&) = delete;
+      Scope& operator = (const Scope&) = delete;
+
+#ifdef ARRAY_STATISTICS
+   private:
+      const char* mPrevious;
+#endif
+   };
+
+   //! count an event, "bytes" are the allocated bytes or the copied bytes
+   static void record(const char* tag, Event event, long long bytes);
+
+   //! print all tags, the largest number of allocated bytes first
+   static void report(FILE* file= stderr);
+
+   //! forget everything counted so far
+   static void reset();
+};
+
+#ifndef ARRAY_STATISTICS
+inline ArrayStatistics::Scope::Scope(const char* /*tag*/)
+{
+}
+
+inline ArrayStatistics::Scope::~Scope()
+{
+}
+#endif
@@ -0,0 +1,411 @@
+#include "bvh.h"
+#include "mesh.h"
+#include "parallel.h"
+
+static const int sBinCount= 16;     // split candidates per node
+static const int sMaxLeafSize= 4;   // triangles per leaf
+static const int sTaskDepth= 4;     // subtrees below this depth are built on separate threads
+
+
+class Bvh::BuildNode
+{
+public:
+   Vector3 mMin;
+   Vector3 mMax;
+   int     mLeft;      //!< left child, -2-task for subtrees built by a task
+   int     mRight;     //!< right child
+   int     mFirst;     //!< first entry in mTriangles
+   int     mCount;     //!< leaf: number of triangles, inner node: 0
+};
+
+
+// half surface area of a box
+static inline float getArea(const Vector3& min, const Vector3& max)
+{
+   const Vector3 d= max - min;
+   return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline void growBounds(Vector3& min, Vector3& max, const Vector3& v)
+{
+   if (v.x < min.x) min.x= v.x;
+   if (v.y < min.y) min.y= v.y;
+   if (v.z < min.z) min.z= v.z;
+   if (v.x > max.x) max.x= v.x;
+   if (v.y > max.y) max.y= v.y;
+   if (v.z > max.z) max.z= v.z;
+}
+
+static inline void resetBounds(Vector3& min, Vector3& max)
+{
+   min= Vector3( 1e30f,  1e30f,  1e30f);
+   max= Vector3(-1e30f, -1e30f, -1e30f);
+}
+
+
+void Bvh::build(const Mesh* mesh)
+{
+   build(mesh->getVertexData(), mesh->getIndexData(), mesh->getIndexCount() / 3);
+}
+
+
+void Bvh::build(const Vector3* vertices, const int* indices, int triangleCount)
+{
+   mVertices= vertices;
+   mIndices= indices;
+
+   const int numTriangles= triangleCount;
+   const int* idx= indices;
+   const Vector3* vtx= vertices;
+
+   mTriangles.init(numTriangles, true);
+   mCentroids.init(numTriangles, true);
+   int* triangles= mTriangles.data();
+   Vector3* centroids= mCentroids.data();
+   parallelFor(numTriangles, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         triangles[i]= i;
+         centroids[i]= (vtx[idx[i*3]] + vtx[idx[i*3+1]] + vtx[idx[i*3+2]]) * (1.0f / 3.0f);
+      }
+   });
+
+   // top levels: collect subtrees (first, count) for the worker threads
+   Array<BuildNode> nodes;
+   Array<int> tasks;
+   if (numTriangles > 0)
+      buildRange(nodes, 0, numTriangles, 0, &tasks);
+
+   // subtrees work on disjoint ranges of mTriangles
+   const int taskCount= tasks.size() / 2;
+   Array< Array<BuildNode> > taskNodes(taskCount, true);
+   parallelFor(taskCount, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int t=begin; t<end; t++)
+         buildRange(taskNodes[t], tasks[t*2], tasks[t*2+1], sTaskDepth, 0);
+   }, 1);
+
+   // every task replaces its placeholder with its own nodes
+   int numNodes= nodes.size() - taskCount;
+   for (int t=0; t<taskCount; t++)
+      numNodes+= taskNodes[t].size();
+
+   mNodes.init(numNodes);
+   if (numTriangles > 0)
+      flatten(nodes, 0, taskNodes.data());
+
+   mCentroids.init(0);
+}
+
+
+int Bvh::buildRange(Array<BuildNode>& nodes, int first, int count, int depth, Array<int>* tasks)
+{
+   int i;
+   BuildNode node;
+   calcBounds(first, count, node.mMin, node.mMax);
+   node.mLeft= -1;
+   node.mRight= -1;
+   node.mFirst= first;
+   node.mCount= count;
+
+   // hand deeper subtrees over to the worker threads
+   if (tasks && depth == sTaskDepth && count > sMaxLeafSize)
+   {
+      node.mLeft= -2 - tasks->size() / 2;
+      tasks->add(first);
+      tasks->add(count);
+      return nodes.add(node);
+   }
+
+   const int index= nodes.add(node);
+   if (count <= sMaxLeafSize)
+      return index;
+
+   int* triangles= mTriangles.data();
+   const Vector3* centroids= mCentroids.data();
+
+   // split along the largest extent of the centroids
+   Vector3 cmin, cmax;
+   resetBounds(cmin, cmax);
+   for (i=first; i<first+count; i++)
+      growBounds(cmin, cmax, centroids[ triangles[i] ]);
+
+   const Vector3 extent= cmax - cmin;
+   int axis= 0;
+   if (extent.y > extent.x) axis= 1;
+   if (extent.z > extent.data()[axis]) axis= 2;
+
+   int mid= count / 2;
+   const float axisMin= cmin.data()[axis];
+   const float axisExtent= extent.data()[axis];
+   if (axisExtent > 0.0f)
+   {
+      // bin the centroids
+      int binCount[sBinCount];
+      Vector3 binMin[sBinCount], binMax[sBinCount];
+      for (int b=0; b<sBinCount; b++)
+      {
+         binCount[b]= 0;
+         resetBounds(binMin[b], binMax[b]);
+      }
+
+      const float scale= sBinCount * 0.9999f / axisExtent;
+      const int* idx= mIndices;
+      const Vector3* vtx= mVertices;
+      for (i=first; i<first+count; i++)
+      {
+         const int triangle= triangles[i];
+         const int b= (int)((centroids[triangle].data()[axis] - axisMin) * scale);
+         binCount[b]++;
+         growBounds(binMin[b], binMax[b], vtx[idx[triangle*3]]);
+         growBounds(binMin[b], binMax[b], vtx[idx[triangle*3+1]]);
+         growBounds(binMin[b], binMax[b], vtx[idx[triangle*3+2]]);
+      }
+
+      // sweep from the right, then evaluate every split from the left
+      float rightArea[sBinCount];
+      int rightCount[sBinCount];
+      Vector3 min, max;
+      resetBounds(min, max);
+      int sum= 0;
+      for (int b=sBinCount-1; b>0; b--)
+      {
+         sum+= binCount[b];
+         growBounds(min, max, binMin[b]);
+         growBounds(min, max, binMax[b]);
+         rightArea[b]= (sum > 0) ? getArea(min, max) : 0.0f;
+         rightCount[b]= sum;
+      }
+
+      int bestSplit= -1;
+      float bestCost= 0.0f;
+      resetBounds(min, max);
+      sum= 0;
+      for (int b=1; b<sBinCount; b++)
+      {
+         sum+= binCount[b-1];
+         if (binCount[b-1] > 0)
+         {
+            growBounds(min, max, binMin[b-1]);
+            growBounds(min, max, binMax[b-1]);
+         }
+
+         if (sum == 0 || rightCount[b] == 0)
+            continue;
+
+         const float cost= getArea(min, max) * sum + rightArea[b] * rightCount[b];
+         if (bestSplit < 0 || cost < bestCost)
+         {
+            bestSplit= b;
+            bestCost= cost;
+         }
+      }
+
+      // partition the range: bins left of the split first
+      if (bestSplit > 0)
+      {
+         int left= first;
+         int right= first + count - 1;
+         while (left <= right)
+         {
+            const int b= (int)((centroids[ triangles[left] ].data()[axis] - axisMin) * scale);
+            if (b < bestSplit)
+            {
+               left++;
+            }
+            else
+            {
+               const int t= triangles[left];
+               triangles[left]= triangles[right];
+               triangles[right]= t;
+               right--;
+            }
+         }
+         mid= left - first;
+      }
+   }
+
+   // identical centroids: split in the middle to keep the tree balanced
+   if (mid <= 0 || mid >= count)
+      mid= count / 2;
+
+   const int left= buildRange(nodes, first, mid, depth + 1, tasks);
+   const int right= buildRange(nodes, first + mid, count - mid, depth + 1, tasks);
+
+   BuildNode& inner= nodes[index];
+   inner.mLeft= left;
+   inner.mRight= right;
+   inner.mCount= 0;
+   return index;
+}
+
+
+int Bvh::flatten(const Array<BuildNode>& nodes, int node, const Array<BuildNode>* taskNodes)
+{
+   const BuildNode& src= nodes[node];
+
+   // subtree built by a task
+   if (src.mLeft < -1)
+      return flatten(taskNodes[-2 - src.mLeft], 0, 0);
+
+   Node dst;
+   dst.mMin= src.mMin;
+   dst.mMax= src.mMax;
+   dst.mSkip= -1;
+   dst.mFirst= src.mFirst;
+   dst.mCount= src.mCount;
+   const int index= mNodes.add(dst);
+
+   if (src.mCount == 0)
+   {
+      flatten(nodes, src.mLeft, taskNodes);
+      mNodes[index].mFirst= flatten(nodes, src.mRight, taskNodes);
+   }
+
+   mNodes[index].mSkip= mNodes.size();
+   return index;
+}
+
+
+void Bvh::calcBounds(int first, int count, Vector3& min, Vector3& max) const
+{
+   const int* idx= mIndices;
+   const Vector3* vtx= mVertices;
+   const int* triangles= mTriangles.data();
+
+   resetBounds(min, max);
+   for (int i=first; i<first+count; i++)
+   {
+      const int triangle= triangles[i];
+      growBounds(min, max, vtx[idx[triangle*3]]);
+      growBounds(min, max, vtx[idx[triangle*3+1]]);
+      growBounds(min, max, vtx[idx[triangle*3+2]]);
+   }
+}
+
+
+void Bvh::refit()
+{
+   const int numNodes= mNodes.size();
+   Node* nodes= mNodes.data();
+
+   // leaves are independent
+   parallelFor(numNodes, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         if (nodes[i].mCount > 0)
+            calcBounds(nodes[i].mFirst, nodes[i].mCount, nodes[i].mMin, nodes[i].mMax);
+      }
+   });
+
+   // children follow their parents, so walking backwards visits them first
+   for (int i=numNodes-1; i>=0; i--)
+   {
+      Node& node= nodes[i];
+      if (node.mCount > 0)
+         continue;
+
+      const Node& left= nodes[i + 1];
+      const Node& right= nodes[node.mFirst];
+      node.mMin= left.mMin;
+      node.mMax= left.mMax;
+      growBounds(node.mMin, node.mMax, right.mMin);
+      growBounds(node.mMin, node.mMax, right.mMax);
+   }
+}
+
+
+bool Bvh::intersect(const Vector3& origin, const Vector3& direction, Hit& hit, float maxDistance) const
+{
+   const int* idx= mIndices;
+   const Vector3* vtx= mVertices;
+   const int* triangles= mTriangles.data();
+   const Vector3 invDir(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+   hit.mTriangle= -1;
+   float best= maxDistance;
+
+   int i= 0;
+   const int numNodes= mNodes.size();
+   while (i < numNodes)
+   {
+      const Node& node= mNodes[i];
+
+      // slab test
+      float tmin= 0.0f;
+      float tmax= best;
+      for (int a=0; a<3; a++)
+      {
+         const float inv= invDir.data()[a];
+         const float o= origin.data()[a];
+         float t1= (node.mMin.data()[a] - o) * inv;
+         float t2= (node.mMax.data()[a] - o) * inv;
+         if (t1 > t2)
+         {
+            const float t= t1;
+            t1= t2;
+            t2= t;
+         }
+         if (t1 > tmin) tmin= t1;
+         if (t2 < tmax) tmax= t2;
+      }
+
+      if (tmin > tmax)
+      {
+         i= node.mSkip;
+         continue;
+      }
+
+      if (node.mCount == 0)
+      {
+         i++;
+         continue;
+      }
+
+      // moeller-trumbore, both sides
+      for (int j=node.mFirst; j<node.mFirst+node.mCount; j++)
+      {
+         const int triangle= triangles[j];
+         const Vector3& v0= vtx[idx[triangle*3]];
+         const Vector3 e1= vtx[idx[triangle*3+1]] - v0;
+         const Vector3 e2= vtx[idx[triangle*3+2]] - v0;
+         const Vector3 p= direction % e2;
+         const float det= e1 * p;
+         if (fabs(det) < 1e-12f)
+            continue;
+
+         const float invDet= 1.0f / det;
+         const Vector3 s= origin - v0;
+         const float u= (s * p) * invDet;
+         if (u < 0.0f || u > 1.0f)
+            continue;
+
+         const Vector3 q= s % e1;
+         const float v= (direction * q) * invDet;
+         if (v < 0.0f || u + v > 1.0f)
+            continue;
+
+         const float t= (e2 * q) * invDet;
+         if (t >= 0.0f && t < best)
+         {
+            best= t;
+            hit.mTriangle= triangle;
+            hit.mDistance= t;
+            hit.mU= u;
+            hit.mV= v;
+         }
+      }
+
+      i= node.mSkip;
+   }
+
+   return (hit.mTriangle >= 0);
+}
+
+
+int Bvh::getNodeCount() const
+{
+   return mNodes.size();
+}
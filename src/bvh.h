@@ -0,0 +1,71 @@
+/*
+ bounding volume hierarchy over the triangles of a mesh for ray casts (picking)
+
+ the tree is built top-down, every node is split where the binned surface area
+ heuristic is cheapest. subtrees below the first few levels are built on all threads.
+
+ nodes are stored depth first: the left child of an inner node directly follows it
+ and every node knows the index behind its subtree (skip). rays are traversed
+ without a stack: enter the next node on a hit, jump to skip on a miss.
+
+ refit() updates the bounds after vertices moved, as long as the triangles stay the same.
+*/
+
+#pragma once
+
+#include "array.h"
+#include "vector3.h"
+
+class Mesh;
+
+class Bvh
+{
+public:
+   class Hit
+   {
+   public:
+      int   mTriangle = -1;    //!< triangle index (-1: nothing hit)
+      float mDistance = 0.0f;  //!< along the ray direction (in units of its length)
+      float mU = 0.0f;         //!< barycentric coordinates of the hit point
+      float mV = 0.0f;
+   };
+
+   Bvh() = default;
+
+   //! build the tree over all triangles of the mesh, the mesh data is referenced, not copied
+   void build(const Mesh* mesh);
+
+   //! same as above for raw vertex and index data, which must stay valid
+   void build(const Vector3* vertices, const int* indices, int triangleCount);
+
+   //! recompute all bounds from the current vertex positions
+   void refit();
+
+   //! closest hit along origin + t * direction with t in [0, maxDistance]
+   bool intersect(const Vector3& origin, const Vector3& direction, Hit& hit, float maxDistance= 1e30f) const;
+
+   int getNodeCount() const;
+
+private:
+   class Node
+   {
+   public:
+      Vector3 mMin;
+      Vector3 mMax;
+      int     mSkip;      //!< node behind this subtree
+      int     mFirst;     //!< leaf: first entry in mTriangles, inner node: right child
+      int     mCount;     //!< leaf: number of triangles, inner node: 0
+   };
+
+   class BuildNode;
+
+   int  buildRange(Array<BuildNode>& nodes, int first, int count, int depth, Array<int>* tasks);
+   int  flatten(const Array<BuildNode>& nodes, int node, const Array<BuildNode>* taskNodes);
+   void calcBounds(int first, int count, Vector3& min, Vector3& max) const;
+
+   const Vector3* mVertices = 0;
+   const int*     mIndices = 0;
+   Array<Node>    mNodes;       //!< depth first
+   Array<int>     mTriangles;   //!< triangle indices referenced by the leaves
+   Array<Vector3> mCentroids;   //!< build only: triangle centroids
+};
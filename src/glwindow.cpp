@@ -1,12 +1,17 @@
 #include "glwindow.h"
 #include "gldevice.h"
+#include "arraystatistics.h"
 
+#include <QKeyEvent>
 #include <QMouseEvent>
 #include <QWheelEvent>
 
 
 extern void initDemo();
 extern void drawDemoFrame(float time);
+extern void pickDemo(float x, float y);
+extern void setDemoLevel(int level);
+extern int getDemoLevel();
 extern float rotX, rotY, posX, posY, posZ;
 
 
@@ -15,6 +20,26 @@ GLWindow::GLWindow(QWidget* parent, const QGLFormat& format)
 {
    mAnimate.setInterval(1000 / 60);
    connect(&mAnimate, SIGNAL(timeout()), this, SLOT(update()));
+
+   // receive key events
+   setFocusPolicy(Qt::StrongFocus);
+}
+
+
+void GLWindow::keyPressEvent(QKeyEvent* ke)
+{
+   // subdivision level: +/- or 0..9
+   if (ke->key() == Qt::Key_Plus)
+      setDemoLevel(getDemoLevel() + 1);
+   else if (ke->key() == Qt::Key_Minus)
+      setDemoLevel(getDemoLevel() - 1);
+   else if (ke->key() >= Qt::Key_0 && ke->key() <= Qt::Key_9)
+      setDemoLevel(ke->key() - Qt::Key_0);
+   // array allocations so far (needs ARRAY_STATISTICS)
+   else if (ke->key() == Qt::Key_S)
+      ArrayStatistics::report();
+   else
+      QGLWidget::keyPressEvent(ke);
 }
 
 
@@ -30,6 +55,14 @@ void GLWindow::mousePressEvent(QMouseEvent* me)
       mMousePos= me->pos();
       mMove = true;
    }
+   else if (me->button() == Qt::MiddleButton)
+   {
+      // pass normalized device coordinates (-1..1, y up)
+      pickDemo(
+         me->pos().x() * 2.0f / width() - 1.0f,
+         1.0f - me->pos().y() * 2.0f / height()
+      );
+   }
 }
 
 
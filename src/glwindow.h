@@ -4,6 +4,7 @@
 #include <QTime>
 #include <QTimer>
 
+class QKeyEvent;
 class QMouseEvent;
 class QWheelEvent;
 
@@ -18,6 +19,7 @@ protected:
    void initializeGL();
    void resizeGL(int w, int h);
    void paintGL();
+   void keyPressEvent(QKeyEvent* ke);
    void mousePressEvent(QMouseEvent* me);
    void mouseReleaseEvent(QMouseEvent* me);
    void mouseMoveEvent(QMouseEvent* me);
@@ -0,0 +1,217 @@
+#include "lazysubdivision.h"
+#include "smallarray.h"
+#include "topology.h"
+#include <utility>
+
+
+LazySubdivision::LazySubdivision(const Mesh* base, int level, int capacity)
+ : mBase(base)
+ , mLevel(level)
+ , mCapacity(capacity > 0 ? capacity : 1)
+{
+   const int numFaces= base->getIndexCount() / 3;
+   mFaceSlots.init(numFaces, true);
+   memset(mFaceSlots.data(), 0xff, numFaces * sizeof(int)); // -1
+
+   mSlotFaces.init(mCapacity, true);
+   mPatches.init(mCapacity, true);
+   mPrev.init(mCapacity, true);
+   mNext.init(mCapacity, true);
+}
+
+
+LazySubdivision::~LazySubdivision()
+{
+   clear();
+}
+
+
+const Mesh* LazySubdivision::getPatch(int face)
+{
+   int slot= mFaceSlots[face];
+
+   if (slot >= 0)
+   {
+      // cache hit: move to front
+      if (slot != mFirst)
+      {
+         unlink(slot);
+         pushFront(slot);
+      }
+      return mPatches[slot];
+   }
+
+   if (mCount < mCapacity)
+   {
+      slot= mCount++;
+   }
+   else
+   {
+      // evict least recently used patch
+      slot= mLast;
+      unlink(slot);
+      mFaceSlots[ mSlotFaces[slot] ]= -1;
+      delete mPatches[slot];
+   }
+
+   mPatches[slot]= buildPatch(face);
+   mSlotFaces[slot]= face;
+   mFaceSlots[face]= slot;
+   pushFront(slot);
+
+   return mPatches[slot];
+}
+
+
+bool LazySubdivision::isCached(int face) const
+{
+   return mFaceSlots[face] >= 0;
+}
+
+
+int LazySubdivision::getLevel() const
+{
+   return mLevel;
+}
+
+
+int LazySubdivision::getCachedCount() const
+{
+   return mCount;
+}
+
+
+void LazySubdivision::clear()
+{
+   for (int slot=0; slot<mCount; slot++)
+   {
+      mFaceSlots[ mSlotFaces[slot] ]= -1;
+      delete mPatches[slot];
+   }
+
+   mCount= 0;
+   mFirst= -1;
+   mLast= -1;
+}
+
+
+Mesh* LazySubdivision::buildPatch(int face) const
+{
+   ArrayStatistics::Scope statistics("lazy subdivision");
+   int i;
+   const Topology& topology= mBase->getTopology();
+   const int* idx= mBase->getIndexData();
+   const Vector3* vtx= mBase->getVertexData();
+
+   // the face comes first so its children are the first 4^level triangles on every level
+   // the one-ring of a regular face has 13 triangles and 12 vertices
+   SmallArray<int, 32> triangles;
+   triangles.add(face);
+   for (i=0; i<3; i++)
+   {
+      const int* corners= topology.getCorners( idx[face*3+i] );
+      const int count= topology.getCornerCount( idx[face*3+i] );
+      for (int j=0; j<count; j++)
+      {
+         const int triangle= corners[j] / 3;
+         if (!triangles.contains(triangle))
+            triangles.add(triangle);
+      }
+   }
+
+   // local copy of the one-ring
+   SmallArray<int, 32> globalVertices;
+   Array<Vector3> localVertices;
+   Array<int> localIndices(triangles.size() * 3);
+   for (i=0; i<triangles.size(); i++)
+   {
+      for (int j=0; j<3; j++)
+      {
+         const int v= idx[ triangles[i]*3+j ];
+         int local= globalVertices.indexOf(v);
+         if (local < 0)
+         {
+            local= globalVertices.add(v);
+            localVertices.add(vtx[v]);
+         }
+         localIndices.add(local);
+      }
+   }
+
+   Mesh* mesh= new Mesh();
+   mesh->setVertices(std::move(localVertices));
+   mesh->setIndices(std::move(localIndices));
+
+   for (i=0; i<mLevel; i++)
+   {
+      Mesh* fine= new Mesh();
+      fine->subDivide(mesh);
+      delete mesh;
+      mesh= fine;
+   }
+
+   // normals see the whole refined ring, so they are correct along the face border too
+   mesh->calcVertexNormals();
+
+   // keep the children of the base face only
+   const int numIndices= 3 << (2*mLevel);
+   const int* srcIdx= mesh->getIndexData();
+   const Vector3* srcVtx= mesh->getVertexData();
+   const Vector3* srcNormals= mesh->getNormalData();
+
+   Array<int> remap(mesh->getVertexCount(), true);
+   memset(remap.data(), 0xff, remap.size() * sizeof(int)); // -1
+
+   Array<int> patchIndices(numIndices, true);
+   Array<Vector3> patchVertices;
+   Array<Vector3> patchNormals;
+   for (i=0; i<numIndices; i++)
+   {
+      const int v= srcIdx[i];
+      if (remap[v] < 0)
+      {
+         remap[v]= patchVertices.add(srcVtx[v]);
+         patchNormals.add(srcNormals[v]);
+      }
+      patchIndices[i]= remap[v];
+   }
+
+   delete mesh;
+
+   Mesh* patch= new Mesh();
+   patch->setVertices(std::move(patchVertices));
+   patch->setNormals(std::move(patchNormals));
+   patch->setIndices(std::move(patchIndices));
+   return patch;
+}
+
+
+void LazySubdivision::unlink(int slot)
+{
+   const int prev= mPrev[slot];
+   const int next= mNext[slot];
+
+   if (prev >= 0)
+      mNext[prev]= next;
+   else
+      mFirst= next;
+
+   if (next >= 0)
+      mPrev[next]= prev;
+   else
+      mLast= prev;
+}
+
+
+void LazySubdivision::pushFront(int slot)
+{
+   mPrev[slot]= -1;
+   mNext[slot]= mFirst;
+
+   if (mFirst >= 0)
+      mPrev[mFirst]= slot;
+   else
+      mLast= slot;
+
+   mFirst= slot;
+}
@@ -0,0 +1,55 @@
+/*
+ on-demand subdivision of single base faces
+
+ getPatch() refines one triangle of the base mesh to the requested level.
+ the triangle is subdivided together with its one-ring (all triangles sharing one of
+ its vertices), which is all loop subdivision needs to get the inner part exact.
+ afterwards only the 4^level triangles inside the base face are kept.
+
+ patches are cached, the least recently used patch is dropped once the cache is full.
+ the base mesh must not change while patches are cached.
+*/
+
+#pragma once
+
+#include "array.h"
+#include "mesh.h"
+
+class LazySubdivision
+{
+public:
+   LazySubdivision(const Mesh* base, int level, int capacity= 256);
+   ~LazySubdivision();
+
+   LazySubdivision(const LazySubdivision&) = delete;
+   LazySubdivision& operator = (const LazySubdivision&) = delete;
+
+   //! refined triangles of the given base face, valid until the next getPatch() call evicts it
+   const Mesh* getPatch(int face);
+
+   //! patch is cached already
+   bool isCached(int face) const;
+
+   int getLevel() const;
+   int getCachedCount() const;
+
+   //! drop all cached patches
+   void clear();
+
+private:
+   Mesh* buildPatch(int face) const;
+   void  unlink(int slot);
+   void  pushFront(int slot);
+
+   const Mesh*  mBase;
+   int          mLevel;
+   int          mCapacity;
+   int          mCount = 0;     //!< slots in use
+   int          mFirst = -1;    //!< most recently used slot
+   int          mLast = -1;     //!< least recently used slot
+   Array<int>   mFaceSlots;     //!< cache slot of each base face (-1: not cached)
+   Array<int>   mSlotFaces;     //!< base face of each slot
+   Array<Mesh*> mPatches;       //!< patch of each slot
+   Array<int>   mPrev;          //!< lru list: more recently used slot
+   Array<int>   mNext;          //!< lru list: less recently used slot
+};
@@ -0,0 +1,180 @@
+#include "lodchain.h"
+#include "mesh.h"
+#include "subdivision.h"
+
+
+void LodChain::build(const Mesh* base, int levels)
+{
+   ArrayStatistics::Scope statistics("lod chain");
+   int i;
+
+   mTopologies.init(levels, true);
+   mVertexOffsets.init(levels + 2, true);
+   mIndexOffsets.init(levels + 2, true);
+
+   // the triangle count is known in advance, the vertex count depends on the edges of each level
+   mVertexOffsets[0]= 0;
+   mVertexOffsets[1]= base->getVertexCount();
+   mIndexOffsets[0]= 0;
+   mIndexOffsets[1]= base->getIndexCount();
+   for (i=1; i<=levels; i++)
+      mIndexOffsets[i+1]= mIndexOffsets[i] + (mIndexOffsets[i] - mIndexOffsets[i-1]) * 4;
+
+   mIndices.init(mIndexOffsets[levels+1], true);
+   memcpy(mIndices.data(), base->getIndexData(), base->getIndexCount() * sizeof(int));
+
+   // topology pass: build the adjacency and triangles level by level
+   Array<int> levelIndices= base->getIndices();
+   for (i=0; i<levels; i++)
+   {
+      Topology& topology= mTopologies[i];
+      topology.build(levelIndices, mVertexOffsets[i+1] - mVertexOffsets[i]);
+      mVertexOffsets[i+2]= mVertexOffsets[i+1] + topology.getVertexCount() + topology.getEdgeCount();
+
+      Array<int> fineIndices;
+      loopSubdivisionIndices(fineIndices, levelIndices, topology);
+      memcpy(mIndices.data() + mIndexOffsets[i+1], fineIndices.data(), fineIndices.size() * sizeof(int));
+      levelIndices= fineIndices;
+   }
+
+   // vertex pass: every level is evaluated straight into its slice
+   mVertices.init(mVertexOffsets[levels+1], true);
+   update(base->getVertices());
+}
+
+
+void LodChain::setLevels(
+      const Array<Vector3>& vertices,
+      const Array<int>& indices,
+      const Array<int>& vertexOffsets,
+      const Array<int>& indexOffsets )
+{
+   mVertices= vertices;
+   mIndices= indices;
+   mVertexOffsets= vertexOffsets;
+   mIndexOffsets= indexOffsets;
+
+   // adjacency is built by getTopology() when needed
+   mTopologies.init(getLevelCount(), true);
+}
+
+
+void LodChain::update(Span<const Vector3> baseVertices)
+{
+   const int levels= getLevelCount();
+
+   copySpan(getLevelVertices(0), baseVertices);
+
+   for (int i=0; i<levels; i++)
+   {
+      loopSubdivisionVertices(
+         getLevelVertices(i+1),
+         getLevelVertices(i),
+         getLevelIndices(i),
+         getTopology(i)
+      );
+   }
+}
+
+
+int LodChain::getLevelCount() const
+{
+   // offsets hold levels + 2 entries
+   return (mVertexOffsets.size() > 1) ? mVertexOffsets.size() - 2 : 0;
+}
+
+
+int LodChain::getVertexCount(int level) const
+{
+   return mVertexOffsets[level+1] - mVertexOffsets[level];
+}
+
+
+Vector3* LodChain::getVertexData(int level) const
+{
+   return mVertices.data() + mVertexOffsets[level];
+}
+
+
+int LodChain::getIndexCount(int level) const
+{
+   return mIndexOffsets[level+1] - mIndexOffsets[level];
+}
+
+
+int* LodChain::getIndexData(int level) const
+{
+   return mIndices.data() + mIndexOffsets[level];
+}
+
+
+Span<Vector3> LodChain::getLevelVertices(int level) const
+{
+   return Span<Vector3>(mVertices).slice(mVertexOffsets[level], mVertexOffsets[level+1]);
+}
+
+
+Span<int> LodChain::getLevelIndices(int level) const
+{
+   return Span<int>(mIndices).slice(mIndexOffsets[level], mIndexOffsets[level+1]);
+}
+
+
+const Topology& LodChain::getTopology(int level) const
+{
+   Topology& topology= mTopologies[level];
+   if (topology.getVertexCount() == 0 && getVertexCount(level) > 0)
+   {
+      // the level's triangles are referenced in place
+      Array<int> indices;
+      indices.setRawData(getIndexData(level), getIndexCount(level));
+      topology.build(indices, getVertexCount(level));
+   }
+   return topology;
+}
+
+
+const Array<Vector3>& LodChain::getVertices() const
+{
+   return mVertices;
+}
+
+
+const Array<int>& LodChain::getIndices() const
+{
+   return mIndices;
+}
+
+
+const Array<int>& LodChain::getVertexOffsets() const
+{
+   return mVertexOffsets;
+}
+
+
+const Array<int>& LodChain::getIndexOffsets() const
+{
+   return mIndexOffsets;
+}
+
+
+long long LodChain::getMemoryUsage() const
+{
+   long long bytes=
+        mVertices.getMemoryUsage()
+      + mIndices.getMemoryUsage()
+      + mVertexOffsets.getMemoryUsage()
+      + mIndexOffsets.getMemoryUsage();
+
+   for (int i=0; i<mTopologies.size(); i++)
+      bytes+= mTopologies[i].getMemoryUsage();
+
+   return bytes;
+}
+
+
+int LodChain::getParentFace(int face, int level, int parentLevel)
+{
+   // every step groups four consecutive triangles
+   return face >> (2 * (level - parentLevel));
+}
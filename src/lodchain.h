@@ -0,0 +1,79 @@
+/*
+ all subdivision levels 0..N of a mesh in shared storage
+
+ loop subdivision keeps the vertex numbering: vertex i of level k is vertex i of
+ level k+1 (smoothed), the edge vertices are appended behind. likewise triangle t
+ of level k becomes triangles 4t..4t+3 of level k+1.
+
+ the positions and triangles of every level live in one allocation each,
+ a level is just an offset into them, so switching levels costs nothing.
+ the adjacency of each level is kept, update() re-evaluates all positions in place
+ after the base vertices moved. levels taken over with setLevels() (e.g. from a mapped
+ MeshFile) build their adjacency on first use.
+
+   vertices: | level 0 | level 1        | level 2                       | ...
+   indices:  | level 0 | level 1        | level 2                       | ...
+*/
+
+#pragma once
+
+#include "array.h"
+#include "span.h"
+#include "topology.h"
+#include "vector3.h"
+
+class Mesh;
+
+class LodChain
+{
+public:
+   LodChain() = default;
+
+   //! subdivide the base mesh "levels" times, level 0 is a copy of the base mesh
+   void build(const Mesh* base, int levels);
+
+   //! take over precomputed levels as returned by the getters below
+   void setLevels(
+      const Array<Vector3>& vertices,
+      const Array<int>& indices,
+      const Array<int>& vertexOffsets,
+      const Array<int>& indexOffsets
+   );
+
+   //! re-evaluate all levels from new base positions (same vertex count and triangles)
+   void update(Span<const Vector3> baseVertices);
+
+   //! number of subdivision steps, levels 0..getLevelCount() exist
+   int getLevelCount() const;
+
+   int      getVertexCount(int level) const;
+   Vector3* getVertexData(int level) const;
+   int      getIndexCount(int level) const;
+   int*     getIndexData(int level) const;
+
+   //! the slices of one level in the storage below, no copy is made
+   Span<Vector3> getLevelVertices(int level) const;
+   Span<int>     getLevelIndices(int level) const;
+
+   //! adjacency of a level, only levels below getLevelCount() are kept
+   const Topology& getTopology(int level) const;
+
+   //! storage of all levels
+   const Array<Vector3>& getVertices() const;
+   const Array<int>&     getIndices() const;
+   const Array<int>&     getVertexOffsets() const;
+   const Array<int>&     getIndexOffsets() const;
+
+   //! heap bytes of all levels and their adjacency (mapped levels are not counted)
+   long long getMemoryUsage() const;
+
+   //! triangle of a coarser level that contains the given triangle
+   static int getParentFace(int face, int level, int parentLevel);
+
+private:
+   Array<Vector3>  mVertices;        //!< positions of all levels
+   Array<int>      mIndices;         //!< triangles of all levels
+   Array<int>      mVertexOffsets;   //!< first vertex of each level (levels + 2 entries)
+   Array<int>      mIndexOffsets;    //!< first index of each level (levels + 2 entries)
+   mutable Array<Topology> mTopologies;   //!< adjacency of levels 0..levels-1, built on demand
+};
@@ -1,9 +1,14 @@
 #include <QApplication>
+#include <QFileInfo>
 
 #include "glwindow.h"
 #include "gldevice.h"
+#include "bvh.h"
+#include "lodchain.h"
 #include "mesh.h"
+#include "meshfile.h"
 #include "objloader.h"
+#include "vertexstream.h"
 #include "vector3.h"
 #include "vector2.h"
 
@@ -13,23 +18,29 @@ unsigned int vertexBuffer;
 unsigned int indexBuffer;
 int indexCount;
 Mesh* baseMesh;
-Mesh* faceMesh;
+MeshFile* meshFile;
+LodChain* lodChain;
+const auto lodLevels = 3;  // subdivision levels built and cached
+int displayLevel = lodLevels;
+Bvh* faceBvh;
+int pickedTriangle = -1;  // triangle of the finest level
 float rotX = 0.0f, rotY = 0.0f, posX = 0.0f, posY = 0.0f, posZ = -50.0f;
 
 
-struct Vertex
-{
-   Vector3 pos;
-   Vector3 normal;
-   float  u,v;
-};
+// vertex buffer layout: positions only, the surface is drawn unlit
+// (a lit or shaded surface would add VertexLayout::NormalHalf and bind it)
+const VertexLayout vertexLayout(VertexLayout::NormalNone, VertexLayout::TexcoordNone);
+int uploadedLevel = -1;
+
+
+const auto aspect = 16.0f / 9.0f;
+const auto zoom = 0.5f;
+const auto zNearPlane = 1.0f;
 
 
 // helper function to set up the opengl projection matrix
 void setPerspective(float scale, float zNear, float zFar)
 {
-   const auto aspect = 16.0f / 9.0f;
-
    auto ymin = -zNear * scale;
    auto ymax = -ymin;
 
@@ -43,55 +54,169 @@ void setPerspective(float scale, float zNear, float zFar)
 
 void initDemo()
 {
-   baseMesh = loadObj("data/face.obj");
-   if (!baseMesh)
+   lodChain = new LodChain();
+
+   // binary cache of the mirrored mesh and its levels: mapped, nothing to compute
+   // it is rebuilt whenever the obj file is newer or the cache holds other levels
+   const auto cacheValid =
+      QFileInfo("data/face.mesh").lastModified() >= QFileInfo("data/face.obj").lastModified();
+
+   meshFile = new MeshFile();
+   if (cacheValid
+      && meshFile->open("data/face.mesh")
+      && meshFile->getLevelCount() == lodLevels
+      && meshFile->getLodChain(*lodChain))
    {
-      qFatal("obj file not found!");
+      baseMesh = meshFile->createMesh();
    }
-
-   baseMesh->symmetryX(0, 0.0f, 0.04f);
-   faceMesh = baseMesh;
-
-   for (auto i = 0; i < 3; i++)
+   else
    {
-      auto temp = faceMesh;
-      faceMesh = new Mesh();
-      faceMesh->subDivide(temp);
+      // the mapping must be gone before save() rewrites the file
+      meshFile->close();
 
-      if (temp != baseMesh)
+      baseMesh = loadObj("data/face.obj");
+      if (!baseMesh)
       {
-         delete temp;
+         qFatal("obj file not found!");
       }
+
+      baseMesh->symmetryX(0, 0.0f, 0.04f);
+
+      // keep all levels, switching between them is free
+      lodChain->build(baseMesh, lodLevels);
+
+      MeshFile::save("data/face.mesh", baseMesh, lodChain);
+   }
+
+   if (displayLevel > lodChain->getLevelCount())
+   {
+      displayLevel = lodChain->getLevelCount();
+   }
+
+   qDebug("memory: base mesh %lld bytes, lod chain %lld bytes",
+      baseMesh->getMemoryUsage().getTotal(),
+      lodChain->getMemoryUsage()
+   );
+
+   // pick on the finest surface
+   const auto finest = lodChain->getLevelCount();
+   faceBvh = new Bvh();
+   faceBvh->build(
+      lodChain->getVertexData(finest),
+      lodChain->getIndexData(finest),
+      lodChain->getIndexCount(finest) / 3
+   );
+}
+
+
+void setDemoLevel(int level)
+{
+   if (level >= 0 && level <= lodChain->getLevelCount())
+   {
+      displayLevel = level;
    }
+}
+
+
+int getDemoLevel()
+{
+   return displayLevel;
+}
+
 
+// rotate v around the x axis (angle in degrees)
+Vector3 rotateX(const Vector3& v, float angle)
+{
+   const auto rad = angle * (float)M_PI / 180.0f;
+   const auto c = cosf(rad);
+   const auto s = sinf(rad);
+   return Vector3(v.x, c * v.y - s * v.z, s * v.y + c * v.z);
+}
+
+
+// rotate v around the y axis (angle in degrees)
+Vector3 rotateY(const Vector3& v, float angle)
+{
+   const auto rad = angle * (float)M_PI / 180.0f;
+   const auto c = cosf(rad);
+   const auto s = sinf(rad);
+   return Vector3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+
+// cast a ray through the given normalized device coordinates
+// and pick the closest triangle of the finest subdivision level
+void pickDemo(float x, float y)
+{
+   // undo projection: point on the near plane in camera space
+   const auto ymax = zNearPlane * zoom;
+   const auto xmax = ymax * aspect;
+   Vector3 origin(-posX, -posY, -posZ);
+   Vector3 direction(x * xmax, y * ymax, -zNearPlane);
+
+   // undo modelview: translate, rotate x, rotate y
+   origin = rotateY(rotateX(origin, -rotX), -rotY);
+   direction = rotateY(rotateX(direction, -rotX), -rotY);
+
+   Bvh::Hit hit;
+   faceBvh->intersect(origin, direction, hit);
+   pickedTriangle = hit.mTriangle;
 }
 
-void drawSurface(Mesh* mesh)
+
+// pack the given level into the vertex and index buffer
+void uploadLevel(int level)
 {
-   auto idx = mesh->getIndexData();
-   const auto idxCount = mesh->getIndexCount();
-   auto pos = mesh->getVertexData();
+   const auto vertexCount = lodChain->getVertexCount(level);
+   indexCount = lodChain->getIndexCount(level);
+
+   // the mesh references the level's data
+   Array<Vector3> vertices;
+   Array<int> indices;
+   vertices.setRawData(lodChain->getVertexData(level), vertexCount);
+   indices.setRawData(lodChain->getIndexData(level), indexCount);
 
-   glBegin(GL_TRIANGLES);
+   Mesh mesh;
+   mesh.setVertices(vertices);
+   mesh.setIndices(indices);
 
-   for (auto i = 0; i < idxCount; i++)
+   if (uploadedLevel >= 0)
    {
-      auto index = idx[i];
-      auto& v = pos[index];
-      glVertex3fv(v);
+      deleteBuffer(vertexBuffer);
+      deleteBuffer(indexBuffer);
    }
 
-   glEnd();
+   // attributes are packed straight into the mapped buffer
+   vertexBuffer = createVertexBuffer(vertexCount * vertexLayout.getStride());
+   writeVertexStream(lockVertexBuffer(vertexBuffer), vertexLayout, &mesh);
+   unlockVertexBuffer(vertexBuffer);
+
+   indexBuffer = createIndexBuffer(indexCount * sizeof(int));
+   memcpy(lockIndexBuffer(indexBuffer), indices.data(), indexCount * sizeof(int));
+   unlockIndexBuffer(indexBuffer);
+
+   uploadedLevel = level;
 }
 
 
-void drawWireframe(Mesh* mesh)
+void drawSurface()
 {
-   glBegin(GL_LINES);
+   glBindBuffer(GL_ARRAY_BUFFER_ARB, vertexBuffer);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, indexBuffer);
+
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glVertexPointer(3, GL_FLOAT, vertexLayout.getStride(), 0);
+   glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+   glDisableClientState(GL_VERTEX_ARRAY);
+
+   glBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
 
-   auto idx = mesh->getIndexData();
-   const auto idxCount = mesh->getIndexCount();
-   auto vtx = mesh->getVertexData();
+
+void drawWireframe(const Vector3* vtx, const int* idx, int idxCount)
+{
+   glBegin(GL_LINES);
 
    for (auto i = 0; i<idxCount; i += 3)
    {
@@ -121,9 +246,9 @@ void drawDemoFrame(float /*time*/)
    glMatrixMode(GL_PROJECTION);
    glLoadIdentity();
    setPerspective(
-      0.5,   // zoom factor
-      1.0,   // smallest z
-      100.0f // largest z
+      zoom,       // zoom factor
+      zNearPlane, // smallest z
+      100.0f      // largest z
    );
 
    // modelview matrix: transform object into 3d space
@@ -136,15 +261,44 @@ void drawDemoFrame(float /*time*/)
    glRotatef(rotX, 1, 0, 0);
    glRotatef(rotY, 0, 1, 0);
 
+   auto vtx = lodChain->getVertexData(displayLevel);
+   auto idx = lodChain->getIndexData(displayLevel);
+   const auto idxCount = lodChain->getIndexCount(displayLevel);
+
+   if (uploadedLevel != displayLevel)
+   {
+      uploadLevel(displayLevel);
+   }
+
    glColor4f(0, 1, 0, 1);
-   drawSurface(faceMesh);
+   drawSurface();
 
    glColor4f(1, 0.3f, 0, 1);
-   drawWireframe(faceMesh);
+   drawWireframe(vtx, idx, idxCount);
+
+   // highlight picked triangle (its ancestor on the displayed level)
+   if (pickedTriangle >= 0)
+   {
+      const auto face = LodChain::getParentFace(
+         pickedTriangle,
+         lodChain->getLevelCount(),
+         displayLevel
+      );
+      idx += face * 3;
+
+      glDisable(GL_DEPTH_TEST);
+      glColor4f(1, 1, 0, 1);
+      glBegin(GL_TRIANGLES);
+      glVertex3fv( vtx[idx[0]] );
+      glVertex3fv( vtx[idx[1]] );
+      glVertex3fv( vtx[idx[2]] );
+      glEnd();
+      glEnable(GL_DEPTH_TEST);
+   }
 
    // draw base mesh (wireframe)
    glColor4f(0, 0, 0, 1);
-   drawWireframe(baseMesh);
+   drawWireframe(baseMesh->getVertexData(), baseMesh->getIndexData(), baseMesh->getIndexCount());
 }
 
 
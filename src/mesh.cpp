@@ -1,5 +1,10 @@
 #include "mesh.h"
 #include "subdivision.h"
+#include "parallel.h"
+#include "simplification.h"
+#include "spatialhash.h"
+#include <stdlib.h>
+#include <utility>
 
 const Array<int>& Mesh::getIndices() const
 {
@@ -9,6 +14,13 @@ const Array<int>& Mesh::getIndices() const
 void Mesh::setIndices(const Array<int>& indices)
 {
    mIndices= indices;
+   invalidateTopology();
+}
+
+void Mesh::setIndices(Array<int>&& indices)
+{
+   mIndices= std::move(indices);
+   invalidateTopology();
 }
 
 const Array<Vector3>& Mesh::getVertices() const
@@ -18,9 +30,21 @@ const Array<Vector3>& Mesh::getVertices() const
 
 void Mesh::setVertices(const Array<Vector3>& vertices)
 {
+   // moving vertices around keeps the adjacency intact
+   if (vertices.size() != mVertices.size())
+      invalidateTopology();
+
    mVertices= vertices;
 }
 
+void Mesh::setVertices(Array<Vector3>&& vertices)
+{
+   if (vertices.size() != mVertices.size())
+      invalidateTopology();
+
+   mVertices= std::move(vertices);
+}
+
 const Array<Vector3>& Mesh::getNormals() const
 {
    return mNormals;
@@ -31,6 +55,11 @@ void Mesh::setNormals(const Array<Vector3>& normals)
    mNormals= normals;
 }
 
+void Mesh::setNormals(Array<Vector3>&& normals)
+{
+   mNormals= std::move(normals);
+}
+
 const Array<Vector2>& Mesh::getTexcoords() const
 {
    return mTexcoords;
@@ -41,6 +70,11 @@ void Mesh::setTexcoords(const Array<Vector2>& texcoords)
    mTexcoords= texcoords;
 }
 
+void Mesh::setTexcoords(Array<Vector2>&& texcoords)
+{
+   mTexcoords= std::move(texcoords);
+}
+
 int Mesh::getVertexCount() const
 {
    return mVertices.size();
@@ -71,95 +105,545 @@ int Mesh::getIndexCount() const
    return mIndices.size();
 }
 
-void Mesh::calcVertexNormals()
+long long Mesh::MemoryUsage::getTotal() const
 {
-   int numIndices= mIndices.size();
-   int numVerts= mVertices.size();
+   return mVertices + mNormals + mTexcoords + mIndices + mFaceNormals + mTopology;
+}
 
-   // init all vertex normals to 0,0,0
-   mNormals.init(numVerts, true);
-   Vector3* vtxNormal= mNormals.data();
-   memset(vtxNormal, 0, numVerts*sizeof(Vector3));
+Mesh::MemoryUsage Mesh::getMemoryUsage() const
+{
+   MemoryUsage usage;
+   usage.mVertices= mVertices.getMemoryUsage();
+   usage.mNormals= mNormals.getMemoryUsage();
+   usage.mTexcoords= mTexcoords.getMemoryUsage();
+   usage.mIndices= mIndices.getMemoryUsage();
+   usage.mFaceNormals= mFaceNormals.getMemoryUsage() + mCornerWeights.getMemoryUsage();
+   usage.mTopology= mTopologyValid ? mTopology.getMemoryUsage() : 0;
+   return usage;
+}
 
-   // calculate face normals and add them to all adjacent faces
-   int* idx= mIndices.data();
-   Vector3* vtx= mVertices.data();
-   while (numIndices-=3)
+SubdivisionMemory Mesh::estimateSubdivisionMemory(int level) const
+{
+   return ::estimateSubdivisionMemory(
+      mVertices.size(),
+      mIndices.size(),
+      getTopology().getEdgeCount(),
+      level
+   );
+}
+
+const Topology& Mesh::getTopology() const
+{
+   if (!mTopologyValid)
    {
-      int i1= *idx++;
-      int i2= *idx++;
-      int i3= *idx++;
+      mTopology.build(mIndices, mVertices.size());
+      mTopologyValid= true;
+   }
+   return mTopology;
+}
+
+void Mesh::invalidateTopology()
+{
+   mFaceNormals.init(0);
+   mCornerWeights.init(0);
 
-      const Vector3& v1= vtx[i1];
-      const Vector3& v2= vtx[i2];
-      const Vector3& v3= vtx[i3];
+   if (mTopologyValid)
+   {
+      mTopology.clear();
+      mTopologyValid= false;
+   }
+}
 
-      Vector3 faceNormal= (v2-v1) % (v3-v1);
+// qsort callback
+static int compareInt(const void* a, const void* b)
+{
+   return *(const int*)a - *(const int*)b;
+}
 
-      vtxNormal[i1] += faceNormal;
-      vtxNormal[i2] += faceNormal;
-      vtxNormal[i3] += faceNormal;
+// give "array" its own copy of the data if other arrays reference it, before writing to it
+template <class Item> static void makeUnique(Array<Item>& array)
+{
+   if (array.getRefCount() > 1)
+   {
+      Array<Item> copy;
+      copy.copy(array);
+      array= std::move(copy);
    }
+}
+
+// sort and remove duplicates, returns new size
+static int sortUnique(int* data, int count)
+{
+   if (count == 0)
+      return 0;
 
-   // normalize vertex normals
-   while (numVerts--)
+   qsort(data, count, sizeof(int), compareInt);
+   int size= 1;
+   for (int i=1; i<count; i++)
    {
-      vtxNormal->normalize();
-      vtxNormal++;
+      if (data[i] != data[size-1])
+         data[size++]= data[i];
    }
+   return size;
 }
 
-void Mesh::symmetryX(int axis, float plane, float eps)
+void Mesh::calcFaceNormals(const int* faces, int count)
+{
+   Vector3* faceNormal= mFaceNormals.data();
+   float* weight= mCornerWeights.data();
+   const int* idx= mIndices.data();
+   const Vector3* vtx= mVertices.data();
+   const NormalWeighting weighting= mNormalWeighting;
+
+   // one pass per triangle: edge vectors, face normal and the weights of its three corners
+   parallelFor(count, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         const int face= faces ? faces[i] : i;
+         const Vector3& v1= vtx[idx[face*3]];
+         const Vector3& v2= vtx[idx[face*3+1]];
+         const Vector3& v3= vtx[idx[face*3+2]];
+
+         const Vector3 e12= v2-v1;
+         const Vector3 e13= v3-v1;
+         const Vector3 e23= v3-v2;
+         const Vector3 n= e12 % e13;
+         faceNormal[face]= n;
+
+         if (weighting == NormalsByArea)
+            continue;
+
+         // |a x b| is the same for all corners, so atan2 gives the angles without acos.
+         // the corners are gathered through the index list, so this loop is not vectorised
+         // either way and the exact angle costs little next to the memory traffic
+         const float len= n.length();
+         float* w= weight + face*3;
+         if (len > 0.0f)
+         {
+            w[0]= atan2f(len, e12 * e13);
+            w[1]= atan2f(len, -(e12 * e23));
+            w[2]= atan2f(len, e13 * e23);
+
+            if (weighting == NormalsByAngle)
+            {
+               const float scale= 1.0f / len;
+               w[0]*= scale;
+               w[1]*= scale;
+               w[2]*= scale;
+            }
+         }
+         else
+         {
+            w[0]= w[1]= w[2]= 0.0f;
+         }
+      }
+   });
+}
+
+void Mesh::gatherVertexNormals(const int* vertices, int count)
+{
+   const Topology& topology= getTopology();
+   const Vector3* faceNormal= mFaceNormals.data();
+   const float* weight= mCornerWeights.data();
+   Vector3* vtxNormal= mNormals.data();
+   parallelFor(count, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         const int v= vertices ? vertices[i] : i;
+         Vector3 n(0.0f, 0.0f, 0.0f);
+
+         const int* corners= topology.getCorners(v);
+         const int cornerCount= topology.getCornerCount(v);
+         if (weight)
+         {
+            for (int j=0; j<cornerCount; j++)
+               n+= faceNormal[ corners[j] / 3 ] * weight[ corners[j] ];
+         }
+         else
+         {
+            for (int j=0; j<cornerCount; j++)
+               n+= faceNormal[ corners[j] / 3 ];
+         }
+
+         // unused vertices keep a zero normal
+         if (cornerCount > 0)
+            n.normalize();
+         vtxNormal[v]= n;
+      }
+   });
+}
+
+void Mesh::calcVertexNormals(NormalWeighting weighting)
+{
+   mNormalWeighting= weighting;
+
+   // face normals: each thread writes its own range of faces
+   const int numFaces= mIndices.size() / 3;
+   if (mFaceNormals.size() != numFaces)
+      mFaceNormals.init(numFaces, true);
+   if (weighting == NormalsByArea)
+      mCornerWeights.init(0);
+   else if (mCornerWeights.size() != numFaces * 3)
+      mCornerWeights.init(numFaces * 3, true);
+   makeUnique(mFaceNormals);
+   makeUnique(mCornerWeights);
+   calcFaceNormals(0, numFaces);
+
+   // gather the normals of all faces around a vertex and normalize them right away
+   // each thread owns a range of vertices, so there is nothing to synchronize
+   mNormals.init(mVertices.size(), true);
+   gatherVertexNormals(0, mVertices.size());
+}
+
+void Mesh::updateVertexNormals(Span<const int> movedVertices)
 {
    int i;
+   const Topology& topology= getTopology();
+
+   if (mFaceNormals.size() != mIndices.size() / 3 || mNormals.size() != mVertices.size())
+   {
+      calcVertexNormals(mNormalWeighting);
+      return;
+   }
+
+   // copies of this mesh share the arrays that are written below
+   makeUnique(mFaceNormals);
+   makeUnique(mCornerWeights);
+   makeUnique(mNormals);
+
+   // faces around the moved vertices
+   Array<int> faces;
+   for (i=0; i<movedVertices.size(); i++)
+   {
+      const int* corners= topology.getCorners(movedVertices[i]);
+      const int count= topology.getCornerCount(movedVertices[i]);
+      for (int j=0; j<count; j++)
+         faces.add(corners[j] / 3);
+   }
+   const int numFaces= sortUnique(faces.data(), faces.size());
+   calcFaceNormals(faces.data(), numFaces);
+
+   // every vertex of these faces sees a changed face normal
+   const int* idx= mIndices.data();
+   Array<int> vertices(numFaces * 3, true);
+   for (i=0; i<numFaces; i++)
+   {
+      vertices[i*3]=   idx[faces[i]*3];
+      vertices[i*3+1]= idx[faces[i]*3+1];
+      vertices[i*3+2]= idx[faces[i]*3+2];
+   }
+   const int numVerts= sortUnique(vertices.data(), vertices.size());
+   gatherVertexNormals(vertices.data(), numVerts);
+}
+
+void Mesh::symmetryX(int axis, float plane, float eps)
+{
+   Vector3 normal(0.0f, 0.0f, 0.0f);
+   normal.data()[axis]= 1.0f;
+   symmetry(normal, plane, eps);
+}
+
+void Mesh::symmetry(const Vector3& normal, float distance, float eps)
+{
    const int numVerts= mVertices.size();
+   const int numIndices= mIndices.size();
+   const Vector3* vtx= mVertices.data();
 
    // alle vertices werden kopiert.
    // bis auf die die auf der Symmetrie-Ebene liegen (weld)
    // jeder vertex wird also auf sich selbst oder auf sein spiegelbild abgebildet
-   Array<int> vertexRemap(numVerts);
-   mVertices.resize(numVerts*2);
-   for (i=0; i<numVerts; i++)
+
+   // seam candidates: vertices within eps on either side of the plane
+   Array<int> seam;
+   Array<Vector3> seamVertices;
+   for (int i=0; i<numVerts; i++)
+   {
+      const float d= vtx[i] * normal - distance;
+      if (fabs(d) < eps)
+      {
+         seam.add(i);
+         seamVertices.add(vtx[i]);
+      }
+   }
+
+   // the mirror image of a seam vertex is welded to the closest seam vertex within eps,
+   // a vertex up to eps from the plane may be further than eps from its own mirror image,
+   // without a partner it is shared by both halves as it is. positions are never moved
+   Array<int> vertexRemap(numVerts, true);
+   int* remap= vertexRemap.data();
+   memset(remap, 0xff, numVerts * sizeof(int)); // -1: copy
+
+   SpatialHash hash;
+   hash.build(seamVertices.data(), seamVertices.size(), eps);
+   parallelFor(seam.size(), [&](int begin, int end, int /*chunk*/)
    {
-      Vector3 v= mVertices[i];
-      float* data= v.data();
-      if (data[axis] < plane+eps) // am rand -> nicht kopieren
+      for (int i=begin; i<end; i++)
       {
-         vertexRemap[i]= i;
+         const Vector3& v= seamVertices[i];
+         const Vector3 mirrored= v - normal * ((v * normal - distance) * 2.0f);
+         const int nearest= hash.findNearest(mirrored, eps);
+         remap[ seam[i] ]= (nearest >= 0) ? seam[nearest] : seam[i];
       }
-      else
+   });
+
+   // count the copies per chunk so all outputs get their exact size up front
+   const int chunkCount= getChunkCount(numVerts);
+   Array<int> chunkCopies(chunkCount + 1, true);
+   int* chunkCopy= chunkCopies.data();
+   parallelFor(numVerts, [&](int begin, int end, int chunk)
+   {
+      int copies= 0;
+      for (int i=begin; i<end; i++)
+         if (remap[i] < 0)
+            copies++;
+      chunkCopy[chunk]= copies;
+   });
+
+   int total= numVerts;
+   for (int chunk=0; chunk<chunkCount; chunk++)
+   {
+      const int copies= chunkCopy[chunk];
+      chunkCopy[chunk]= total;
+      total+= copies;
+   }
+
+   // mirrored vertices follow the original ones
+   const bool hasNormals= (mNormals.size() == numVerts);
+   const bool hasTexcoords= (mTexcoords.size() == numVerts);
+   Array<Vector3> vertices(total, true);
+   Array<Vector3> normals(hasNormals ? total : 0, true);
+   Array<Vector2> texcoords(hasTexcoords ? total : 0, true);
+   memcpy(vertices.data(), vtx, numVerts * sizeof(Vector3));
+   if (hasNormals)
+      memcpy(normals.data(), mNormals.data(), numVerts * sizeof(Vector3));
+   if (hasTexcoords)
+      memcpy(texcoords.data(), mTexcoords.data(), numVerts * sizeof(Vector2));
+
+   parallelFor(numVerts, [&](int begin, int end, int chunk)
+   {
+      int index= chunkCopy[chunk];
+      for (int i=begin; i<end; i++)
       {
-         data[axis]= plane*2.0f-data[axis];
-         vertexRemap[i]= mVertices.add( v );
+         if (remap[i] >= 0)
+            continue;
+
+         const Vector3& v= vtx[i];
+
+         vertices[index]= v - normal * ((v * normal - distance) * 2.0f);
+         if (hasNormals)
+         {
+            const Vector3& n= mNormals[i];
+            normals[index]= n - normal * ((n * normal) * 2.0f);
+         }
+         if (hasTexcoords)
+            texcoords[index]= mTexcoords[i];
+         remap[i]= index++;
+      }
+   });
+
+   // mirrored triangles follow the original ones
+   Array<int> indices(numIndices * 2, true);
+   const int* srcIdx= mIndices.data();
+   int* dstIdx= indices.data();
+   memcpy(dstIdx, srcIdx, numIndices * sizeof(int));
+   dstIdx+= numIndices;
+   parallelFor(numIndices / 3, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin*3; i<end*3; i+=3)
+      {
+         dstIdx[i]=   remap[ srcIdx[i] ]; // flip winding!
+         dstIdx[i+1]= remap[ srcIdx[i+2] ];
+         dstIdx[i+2]= remap[ srcIdx[i+1] ];
+      }
+   });
+
+   mVertices= std::move(vertices);
+   mIndices= std::move(indices);
+   if (hasNormals)
+      mNormals= std::move(normals);
+   if (hasTexcoords)
+      mTexcoords= std::move(texcoords);
+
+   invalidateTopology();
+}
+
+
+int Mesh::weld(float eps)
+{
+   int i;
+   const int numVerts= mVertices.size();
+   const Vector3* vtx= mVertices.data();
+
+   // each vertex points to the smallest vertex index within eps,
+   // with texcoords only to one with the same texcoord so uv seams stay open
+   const bool hasTexcoords= (mTexcoords.size() == numVerts);
+   const Vector2* tex= mTexcoords.data();
+   SpatialHash hash;
+   hash.build(vtx, numVerts, eps);
+
+   Array<int> vertexRemap(numVerts, true);
+   int* remap= vertexRemap.data();
+   parallelFor(numVerts, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         if (!hasTexcoords)
+         {
+            remap[i]= hash.findFirst(vtx[i], eps);
+            continue;
+         }
+
+         int first= i;
+         hash.forEachNear(vtx[i], eps, [&](int index, float /*dist2*/)
+         {
+            if (index < first && tex[index] == tex[i])
+               first= index;
+         });
+         remap[i]= first;
       }
+   });
+
+   // follow chains down to the vertex that is kept and number the kept vertices.
+   // remap[i] <= i, so the target of i has been resolved already
+   int count= 0;
+   for (i=0; i<numVerts; i++)
+      remap[i]= (remap[i] == i) ? count++ : remap[ remap[i] ];
+
+   if (count == numVerts)
+      return 0;
+
+   // kept vertices keep their normal and texcoord
+   const bool hasNormals= (mNormals.size() == numVerts);
+   Array<Vector3> vertices(count, true);
+   Array<Vector3> normals(hasNormals ? count : 0, true);
+   Array<Vector2> texcoords(hasTexcoords ? count : 0, true);
+   int kept= 0;
+   for (i=0; i<numVerts; i++)
+   {
+      if (remap[i] != kept)
+         continue;
+
+      vertices[kept]= vtx[i];
+      if (hasNormals)
+         normals[kept]= mNormals[i];
+      if (hasTexcoords)
+         texcoords[kept]= mTexcoords[i];
+      kept++;
    }
 
+   // remap indices in place and drop triangles that collapsed
+   makeUnique(mIndices);
+
    const int numIndices= mIndices.size();
-   mIndices.resize(numIndices*2);
+   int* idx= mIndices.data();
+   int numWelded= 0;
    for (i=0; i<numIndices; i+=3)
    {
-      int i1= mIndices[i];
-      int i2= mIndices[i+1];
-      int i3= mIndices[i+2];
-      int m1= vertexRemap[i1];
-      int m2= vertexRemap[i2];
-      int m3= vertexRemap[i3];
-      mIndices.add(m1); // flip winding!
-      mIndices.add(m3);
-      mIndices.add(m2);
+      const int i1= remap[ idx[i] ];
+      const int i2= remap[ idx[i+1] ];
+      const int i3= remap[ idx[i+2] ];
+      if (i1 == i2 || i2 == i3 || i3 == i1)
+         continue;
+
+      idx[numWelded++]= i1;
+      idx[numWelded++]= i2;
+      idx[numWelded++]= i3;
    }
+
+   if (numWelded < numIndices)
+      mIndices.resize(numWelded);
+
+   mVertices= std::move(vertices);
+   if (hasNormals)
+      mNormals= std::move(normals);
+   if (hasTexcoords)
+      mTexcoords= std::move(texcoords);
+
+   invalidateTopology();
+
+   return numVerts - count;
 }
 
 
-void Mesh::subDivide(Mesh* mesh)
+int Mesh::simplify(int targetTriangles, float maxError)
 {
+   int i;
+   const int numVerts= mVertices.size();
+
+   Array<int> indices;
+   simplifyTriangles(indices, mVertices, mIndices, getTopology(), targetTriangles, maxError);
+
+   // number the vertices that are still in use
+   Array<int> vertexRemap(numVerts, true);
+   int* remap= vertexRemap.data();
+   memset(remap, 0xff, numVerts * sizeof(int)); // -1
+
+   const int numIndices= indices.size();
+   int* idx= indices.data();
+   for (i=0; i<numIndices; i++)
+      remap[ idx[i] ]= 0;
+
+   int count= 0;
+   for (i=0; i<numVerts; i++)
+   {
+      if (remap[i] == 0)
+         remap[i]= count++;
+   }
+
+   for (i=0; i<numIndices; i++)
+      idx[i]= remap[ idx[i] ];
+
+   const bool hasNormals= (mNormals.size() == numVerts);
+   const bool hasTexcoords= (mTexcoords.size() == numVerts);
+   Array<Vector3> vertices(count, true);
+   Array<Vector3> normals(hasNormals ? count : 0, true);
+   Array<Vector2> texcoords(hasTexcoords ? count : 0, true);
+   for (i=0; i<numVerts; i++)
+   {
+      const int kept= remap[i];
+      if (kept < 0)
+         continue;
+
+      vertices[kept]= mVertices[i];
+      if (hasNormals)
+         normals[kept]= mNormals[i];
+      if (hasTexcoords)
+         texcoords[kept]= mTexcoords[i];
+   }
+
+   mVertices= std::move(vertices);
+   mIndices= std::move(indices);
+   if (hasNormals)
+      mNormals= std::move(normals);
+   if (hasTexcoords)
+      mTexcoords= std::move(texcoords);
+
+   invalidateTopology();
+
+   return numIndices / 3;
+}
+
+
+void Mesh::subDivide(const Mesh* mesh, SubdivisionMemory* memory)
+{
+   const bool buildTopology= !mesh->mTopologyValid;
+
    loopSubdivision(
             mVertices,
             mIndices,
             mesh->getVertices(),
-            mesh->getIndices()
+            mesh->getIndices(),
+            mesh->getTopology(),
+            memory
    );
 
+   if (memory && buildTopology)
+      memory->mTransient= mesh->getTopology().getBuildPeak();
+
+   invalidateTopology();
+
    // no normals!
    // no uvs!
 }
@@ -1,12 +1,37 @@
 #pragma once
 
 #include "array.h"
+#include "span.h"
+#include "subdivision.h"
+#include "topology.h"
 #include "vector2.h"
 #include "vector3.h"
 
 class Mesh
 {
 public:
+   // how face normals contribute to vertex normals
+   enum NormalWeighting
+   {
+      NormalsByArea,          //!< face normal scaled by triangle area
+      NormalsByAngle,         //!< unit face normal scaled by the corner angle
+      NormalsByAreaAndAngle   //!< face normal scaled by triangle area and corner angle
+   };
+
+   // heap bytes held by a mesh, mapped (raw) data is not counted
+   class MemoryUsage
+   {
+   public:
+      long long mVertices = 0;
+      long long mNormals = 0;
+      long long mTexcoords = 0;
+      long long mIndices = 0;
+      long long mFaceNormals = 0;     //!< normal cache, including the corner weights
+      long long mTopology = 0;        //!< cached adjacency
+
+      long long getTotal() const;
+   };
+
    Mesh() = default;
 
    int                   getIndexCount() const;
@@ -16,24 +41,70 @@ public:
    Vector3*              getNormalData() const;
    Vector2*              getTexcoordData() const;
 
+   // setters share the data with the given array, the rvalue versions take it over
+   // (use std::move() to hand over an array that is not needed anymore)
    void                  setIndices(const Array<int>& indices);
+   void                  setIndices(Array<int>&& indices);
    const Array<int>&     getIndices() const;
    void                  setVertices(const Array<Vector3>& vertices);
+   void                  setVertices(Array<Vector3>&& vertices);
    const Array<Vector3>& getVertices() const;
    void                  setNormals(const Array<Vector3>& normals);
+   void                  setNormals(Array<Vector3>&& normals);
    const Array<Vector3>& getNormals() const;
    void                  setTexcoords(const Array<Vector2>& texcoords);
+   void                  setTexcoords(Array<Vector2>&& texcoords);
    const Array<Vector2>& getTexcoords() const;
 
+   // mirror the mesh at the plane (normal * x = distance), normal is unit length
+   // vertices within eps of the plane on either side are welded with their mirror image,
+   // or shared by both halves if there is none. positions are kept
+   void                  symmetry(const Vector3& normal, float distance, float eps);
    void                  symmetryX(int axis, float plane, float eps); // axis: 0=x, 1=y, 2=z
-   void                  subDivide(Mesh* mesh);
+   // fill this mesh with the subdivided "mesh", the memory of the step is reported if given
+   // (transient: adjacency of "mesh" if it was built for this call, it stays cached there)
+   void                  subDivide(const Mesh* mesh, SubdivisionMemory* memory= 0);
+
+   // predict the memory of the step creating subdivision "level" from this mesh
+   SubdivisionMemory     estimateSubdivisionMemory(int level) const;
+
+   // merge vertices closer than eps and drop collapsed triangles, with texcoords
+   // only vertices with the same texcoord are merged (uv seams are kept)
+   // the smallest vertex index of a group keeps its normal and texcoord
+   // returns the number of removed vertices
+   int                   weld(float eps);
+
+   // quadric error simplification down to targetTriangles (see simplification.h),
+   // unused vertices are dropped, boundaries and uv seams are kept
+   // returns the number of remaining triangles
+   int                   simplify(int targetTriangles, float maxError= 1e30f);
 
-   void                  calcVertexNormals();
+   void                  calcVertexNormals(NormalWeighting weighting= NormalsByArea);
+
+   // recompute the normals around the given moved vertices only,
+   // uses the face normals and weighting of the last calcVertexNormals() call
+   void                  updateVertexNormals(Span<const int> movedVertices);
+
+   MemoryUsage           getMemoryUsage() const;
+
+   // adjacency is built on first use and dropped whenever the triangles change
+   const Topology&       getTopology() const;
+   void                  invalidateTopology();
 
 private:
+   // null lists mean all faces/vertices 0..count-1
+   void                  calcFaceNormals(const int* faces, int count);
+   void                  gatherVertexNormals(const int* vertices, int count);
+
    Array<Vector3>        mVertices;     //!< vertex positions
    Array<Vector3>        mNormals;      //!< vertex normals (1 per vertex position)
    Array<Vector2>        mTexcoords;    //!< texture coordinates (1 per vertex psoition)
    Array<int>            mIndices;      //!< triangles (3 vertex indices per triangle)
+   Array<Vector3>        mFaceNormals;  //!< unnormalized face normals (1 per triangle)
+   Array<float>          mCornerWeights;//!< face normal weights (1 per index, empty for NormalsByArea)
+   NormalWeighting       mNormalWeighting = NormalsByArea;
+
+   mutable Topology      mTopology;     //!< cached adjacency of mIndices
+   mutable bool          mTopologyValid = false;
 };
 
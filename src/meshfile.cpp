@@ -0,0 +1,329 @@
+#include "meshfile.h"
+#include "lodchain.h"
+#include "mesh.h"
+#include <utility>
+
+static const char sMagic[8]= "SUBSURF";
+static const int sVersion= 1;
+static const int sAlignment= 64;   // blob alignment in bytes
+
+// blobs in file order
+enum Blob
+{
+   BaseVertices,
+   BaseNormals,
+   BaseTexcoords,
+   BaseIndices,
+   LevelVertices,
+   LevelIndices,
+   LevelVertexOffsets,
+   LevelIndexOffsets,
+   BlobCount
+};
+
+// size of a single item of each blob
+static const int sItemSizes[BlobCount]=
+{
+   sizeof(Vector3), sizeof(Vector3), sizeof(Vector2), sizeof(int),
+   sizeof(Vector3), sizeof(int), sizeof(int), sizeof(int)
+};
+
+
+class MeshFile::Header
+{
+public:
+   char   mMagic[8];
+   int    mVersion;
+   int    mLevelCount;
+   qint64 mOffsets[BlobCount];   //!< from the start of the file
+   qint64 mSizes[BlobCount];     //!< in bytes
+};
+
+
+// reference a mapped blob without copying
+template <class Item> static void mapArray(Array<Item>& array, unsigned char* data, const qint64* offsets, const qint64* sizes, int blob)
+{
+   if (sizes[blob] > 0)
+      array.setRawData((Item*)(data + offsets[blob]), (int)(sizes[blob] / sizeof(Item)));
+}
+
+
+// whole triangles that only refer to the first "vertexCount" vertices
+static bool checkIndices(const int* indices, qint64 count, qint64 vertexCount)
+{
+   if (count % 3 != 0)
+      return false;
+
+   for (qint64 i=0; i<count; i++)
+   {
+      if (indices[i] < 0 || indices[i] >= vertexCount)
+         return false;
+   }
+   return true;
+}
+
+
+MeshFile::~MeshFile()
+{
+   close();
+}
+
+
+bool MeshFile::save(const char* filename, const Mesh* mesh, const LodChain* lodChain)
+{
+   int i;
+   const void* blobs[BlobCount];
+   qint64 counts[BlobCount];
+
+   blobs[BaseVertices]= mesh->getVertexData();
+   blobs[BaseNormals]= mesh->getNormalData();
+   blobs[BaseTexcoords]= mesh->getTexcoordData();
+   blobs[BaseIndices]= mesh->getIndexData();
+   counts[BaseVertices]= mesh->getVertexCount();
+   counts[BaseNormals]= mesh->getNormals().size();
+   counts[BaseTexcoords]= mesh->getTexcoords().size();
+   counts[BaseIndices]= mesh->getIndexCount();
+
+   for (i=LevelVertices; i<BlobCount; i++)
+   {
+      blobs[i]= 0;
+      counts[i]= 0;
+   }
+
+   if (lodChain && lodChain->getLevelCount() > 0)
+   {
+      blobs[LevelVertices]= lodChain->getVertices().data();
+      blobs[LevelIndices]= lodChain->getIndices().data();
+      blobs[LevelVertexOffsets]= lodChain->getVertexOffsets().data();
+      blobs[LevelIndexOffsets]= lodChain->getIndexOffsets().data();
+      counts[LevelVertices]= lodChain->getVertices().size();
+      counts[LevelIndices]= lodChain->getIndices().size();
+      counts[LevelVertexOffsets]= lodChain->getVertexOffsets().size();
+      counts[LevelIndexOffsets]= lodChain->getIndexOffsets().size();
+   }
+
+   // place the blobs behind the header
+   Header header;
+   memset(&header, 0, sizeof(Header));
+   memcpy(header.mMagic, sMagic, sizeof(sMagic));
+   header.mVersion= sVersion;
+   header.mLevelCount= (counts[LevelVertices] > 0) ? lodChain->getLevelCount() : 0;
+
+   qint64 offset= sizeof(Header);
+   for (i=0; i<BlobCount; i++)
+   {
+      offset= (offset + sAlignment - 1) / sAlignment * sAlignment;
+      header.mOffsets[i]= offset;
+      header.mSizes[i]= counts[i] * sItemSizes[i];
+      offset+= header.mSizes[i];
+   }
+
+   QFile file(filename);
+   if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+   {
+      qDebug("cannot write mesh file: %s", filename);
+      return false;
+   }
+
+   bool ok= (file.write((const char*)&header, sizeof(Header)) == sizeof(Header));
+   const char padding[sAlignment]= {0};
+   for (i=0; i<BlobCount && ok; i++)
+   {
+      const qint64 gap= header.mOffsets[i] - file.pos();
+      ok= (file.write(padding, gap) == gap);
+      if (ok && header.mSizes[i] > 0)
+         ok= (file.write((const char*)blobs[i], header.mSizes[i]) == header.mSizes[i]);
+   }
+
+   file.close();
+   if (!ok)
+   {
+      qDebug("failed to write mesh file: %s", filename);
+      file.remove();
+   }
+
+   return ok;
+}
+
+
+bool MeshFile::open(const char* filename)
+{
+   int i;
+   close();
+
+   mFile.setFileName(filename);
+   if (!mFile.open(QIODevice::ReadOnly))
+      return false;
+
+   const qint64 fileSize= mFile.size();
+   if (fileSize >= (qint64)sizeof(Header))
+   {
+      // private mapping: pages are copied when written to
+      mData= mFile.map(0, fileSize, QFileDevice::MapPrivateOption);
+   }
+
+   if (!mData)
+   {
+      close();
+      return false;
+   }
+
+   const Header* header= (const Header*)mData;
+   bool valid=
+         memcmp(header->mMagic, sMagic, sizeof(sMagic)) == 0
+      && header->mVersion == sVersion
+      && header->mLevelCount >= 0;
+
+   for (i=0; i<BlobCount && valid; i++)
+   {
+      const qint64 offset= header->mOffsets[i];
+      const qint64 size= header->mSizes[i];
+      valid=
+            offset % sAlignment == 0
+         && offset >= (qint64)sizeof(Header)
+         && size >= 0
+         && size % sItemSizes[i] == 0
+         && size / sItemSizes[i] <= 0x7fffffff
+         && offset + size <= fileSize;
+   }
+
+   // levels: one offset per level plus the base and the end
+   if (valid && header->mLevelCount > 0)
+   {
+      const qint64 offsetCount= header->mLevelCount + 2;
+      valid=
+            header->mSizes[LevelVertexOffsets] == offsetCount * (qint64)sizeof(int)
+         && header->mSizes[LevelIndexOffsets] == offsetCount * (qint64)sizeof(int);
+
+      const int* vertexOffsets= (const int*)(mData + header->mOffsets[LevelVertexOffsets]);
+      const int* indexOffsets= (const int*)(mData + header->mOffsets[LevelIndexOffsets]);
+      for (i=0; i<offsetCount && valid; i++)
+      {
+         valid=
+               vertexOffsets[i] >= ((i > 0) ? vertexOffsets[i-1] : 0)
+            && indexOffsets[i] >= ((i > 0) ? indexOffsets[i-1] : 0);
+      }
+
+      valid= valid
+         && vertexOffsets[0] == 0
+         && indexOffsets[0] == 0
+         && vertexOffsets[offsetCount-1] * (qint64)sizeof(Vector3) == header->mSizes[LevelVertices]
+         && indexOffsets[offsetCount-1] * (qint64)sizeof(int) == header->mSizes[LevelIndices];
+
+      // indices of each level count from the first vertex of that level
+      const int* indices= (const int*)(mData + header->mOffsets[LevelIndices]);
+      for (i=0; i<offsetCount-1 && valid; i++)
+      {
+         valid= checkIndices(
+            indices + indexOffsets[i],
+            indexOffsets[i+1] - indexOffsets[i],
+            vertexOffsets[i+1] - vertexOffsets[i]
+         );
+      }
+   }
+
+   // normals and texcoords are per vertex or missing, level 0 is the base mesh
+   const qint64 vertexCount= header->mSizes[BaseVertices] / (qint64)sizeof(Vector3);
+   if (valid)
+   {
+      const qint64 normalCount= header->mSizes[BaseNormals] / (qint64)sizeof(Vector3);
+      const qint64 texcoordCount= header->mSizes[BaseTexcoords] / (qint64)sizeof(Vector2);
+      valid=
+            (normalCount == 0 || normalCount == vertexCount)
+         && (texcoordCount == 0 || texcoordCount == vertexCount);
+   }
+
+   if (valid && header->mLevelCount > 0)
+   {
+      const int* vertexOffsets= (const int*)(mData + header->mOffsets[LevelVertexOffsets]);
+      const int* indexOffsets= (const int*)(mData + header->mOffsets[LevelIndexOffsets]);
+      valid=
+            vertexOffsets[1] == vertexCount
+         && indexOffsets[1] * (qint64)sizeof(int) == header->mSizes[BaseIndices];
+   }
+
+   // the mesh and the lod chain index the vertices without further checks
+   if (valid)
+   {
+      valid= checkIndices(
+         (const int*)(mData + header->mOffsets[BaseIndices]),
+         header->mSizes[BaseIndices] / sizeof(int),
+         vertexCount
+      );
+   }
+
+   if (!valid)
+   {
+      qDebug("mesh file is outdated or damaged: %s", filename);
+      close();
+      return false;
+   }
+
+   mHeader= header;
+   return true;
+}
+
+
+void MeshFile::close()
+{
+   if (mData)
+      mFile.unmap(mData);
+   mFile.close();
+
+   mData= 0;
+   mHeader= 0;
+}
+
+
+int MeshFile::getLevelCount() const
+{
+   return mHeader ? mHeader->mLevelCount : 0;
+}
+
+
+Mesh* MeshFile::createMesh() const
+{
+   if (!mHeader)
+      return 0;
+
+   const qint64* offsets= mHeader->mOffsets;
+   const qint64* sizes= mHeader->mSizes;
+
+   Array<Vector3> vertices;
+   Array<Vector3> normals;
+   Array<Vector2> texcoords;
+   Array<int> indices;
+   mapArray(vertices, mData, offsets, sizes, BaseVertices);
+   mapArray(normals, mData, offsets, sizes, BaseNormals);
+   mapArray(texcoords, mData, offsets, sizes, BaseTexcoords);
+   mapArray(indices, mData, offsets, sizes, BaseIndices);
+
+   Mesh* mesh= new Mesh();
+   mesh->setVertices(std::move(vertices));
+   mesh->setNormals(std::move(normals));
+   mesh->setTexcoords(std::move(texcoords));
+   mesh->setIndices(std::move(indices));
+   return mesh;
+}
+
+
+bool MeshFile::getLodChain(LodChain& lodChain) const
+{
+   if (getLevelCount() == 0)
+      return false;
+
+   const qint64* offsets= mHeader->mOffsets;
+   const qint64* sizes= mHeader->mSizes;
+
+   Array<Vector3> vertices;
+   Array<int> indices;
+   Array<int> vertexOffsets;
+   Array<int> indexOffsets;
+   mapArray(vertices, mData, offsets, sizes, LevelVertices);
+   mapArray(indices, mData, offsets, sizes, LevelIndices);
+   mapArray(vertexOffsets, mData, offsets, sizes, LevelVertexOffsets);
+   mapArray(indexOffsets, mData, offsets, sizes, LevelIndexOffsets);
+
+   lodChain.setLevels(vertices, indices, vertexOffsets, indexOffsets);
+   return true;
+}
@@ -0,0 +1,53 @@
+/*
+ binary mesh container, made to be mapped into memory instead of parsed
+
+ file layout (native byte order):
+   header:  magic "SUBSURF", version, level count, one (offset, size) entry per blob
+   blobs:   raw arrays, each starting at a multiple of 64 bytes
+            base mesh:  vertices, normals, texcoords, indices
+            optional:   subdivision levels as stored by LodChain
+                        (vertices, indices, vertex offsets, index offsets)
+
+ open() maps the file, meshes and lod chains created from it reference the mapped
+ memory directly (see Array::setRawData) and must not outlive the MeshFile.
+ the mapping is private: writes to the arrays stay in memory and never reach the file.
+ files with a different version or inconsistent sizes and indices are rejected,
+ the caller is expected to rebuild them.
+*/
+
+#pragma once
+
+#include <QFile>
+
+class LodChain;
+class Mesh;
+
+class MeshFile
+{
+public:
+   MeshFile() = default;
+   ~MeshFile();
+
+   //! write the mesh and, if given, all levels of the lod chain
+   static bool save(const char* filename, const Mesh* mesh, const LodChain* lodChain= 0);
+
+   //! map the given file, false if it does not exist or does not match this version
+   bool open(const char* filename);
+   void close();
+
+   //! number of stored subdivision levels (0: none)
+   int getLevelCount() const;
+
+   //! base mesh referencing the mapped data, owned by the caller
+   Mesh* createMesh() const;
+
+   //! let the lod chain reference the stored levels, false if there are none
+   bool getLodChain(LodChain& lodChain) const;
+
+private:
+   class Header;
+
+   QFile          mFile;
+   unsigned char* mData = 0;
+   const Header*  mHeader = 0;
+};
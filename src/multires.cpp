@@ -0,0 +1,183 @@
+#include "multires.h"
+#include "topology.h"
+
+
+// local frame of vertex v: normal plus the direction to its first edge neighbour
+static void getFrame(const Mesh* mesh, int v, Vector3& tangent, Vector3& bitangent, Vector3& normal)
+{
+   const Topology& topology= mesh->getTopology();
+   const Vector3* vtx= mesh->getVertexData();
+   normal= mesh->getNormalData()[v];
+
+   Vector3 dir(1.0f, 0.0f, 0.0f);
+   if (topology.getVertexEdgeCount(v) > 0)
+   {
+      const int e= topology.getVertexEdges(v)[0];
+      const int e1= topology.getEdgeVertex(e, 0);
+      const int neighbour= (e1 == v) ? topology.getEdgeVertex(e, 1) : e1;
+      dir= vtx[neighbour] - vtx[v];
+   }
+
+   tangent= dir - normal * (normal * dir);
+   if (tangent.length2() < EPS*EPS)
+   {
+      // edge runs along the normal, pick any perpendicular axis
+      tangent= (fabs(normal.x) < 0.9f) ? Vector3(1.0f, 0.0f, 0.0f) : Vector3(0.0f, 1.0f, 0.0f);
+      tangent-= normal * (normal * tangent);
+   }
+   tangent.normalize();
+   bitangent= normal % tangent;
+}
+
+
+MultiresMesh::MultiresMesh(const Mesh* base)
+ : mBase(base)
+{
+}
+
+
+const Mesh* MultiresMesh::getBase() const
+{
+   return mBase;
+}
+
+
+int MultiresMesh::getLevelCount() const
+{
+   return mLevels.size();
+}
+
+
+void MultiresMesh::setLevelCount(int count)
+{
+   while (mLevels.size() < count)
+      mLevels.add(Level());
+
+   while (mLevels.size() > count)
+   {
+      clearDisplacements(mLevels.size());
+      mLevels.takeLast();
+   }
+}
+
+
+int MultiresMesh::encode(int level, const Array<Vector3>& sculpted, float eps)
+{
+   if (level < 1 || level > getLevelCount() + 1)
+      return 0;
+
+   if (level > getLevelCount())
+      setLevelCount(level);
+
+   Mesh* coarse= evaluate(level - 1);
+   Mesh* smooth= subdivideSmooth(coarse);
+   delete coarse;
+
+   Level& data= mLevels[level - 1];
+   data.mIndices.init(0);
+   data.mDisplacements.init(0);
+
+   const Vector3* vtx= smooth->getVertexData();
+   const int numVerts= smooth->getVertexCount();
+   for (int v=0; v<numVerts && v<sculpted.size(); v++)
+   {
+      const Vector3 d= sculpted[v] - vtx[v];
+      if (d.length2() <= eps*eps)
+         continue;
+
+      Vector3 tangent, bitangent, normal;
+      getFrame(smooth, v, tangent, bitangent, normal);
+      data.mIndices.add(v);
+      data.mDisplacements.add( Vector3(d * tangent, d * bitangent, d * normal) );
+   }
+
+   delete smooth;
+   return data.mIndices.size();
+}
+
+
+void MultiresMesh::setDisplacements(int level, const Array<int>& vertexIndices, const Array<Vector3>& displacements)
+{
+   if (level > getLevelCount())
+      setLevelCount(level);
+
+   Level& data= mLevels[level - 1];
+   data.mIndices= vertexIndices;
+   data.mDisplacements= displacements;
+}
+
+
+const Array<int>& MultiresMesh::getDisplacementIndices(int level) const
+{
+   return mLevels[level - 1].mIndices;
+}
+
+
+const Array<Vector3>& MultiresMesh::getDisplacements(int level) const
+{
+   return mLevels[level - 1].mDisplacements;
+}
+
+
+void MultiresMesh::clearDisplacements(int level)
+{
+   Level& data= mLevels[level - 1];
+   data.mIndices.init(0);
+   data.mDisplacements.init(0);
+}
+
+
+Mesh* MultiresMesh::evaluate(int level) const
+{
+   Mesh* mesh= new Mesh();
+   mesh->setVertices(mBase->getVertices());
+   mesh->setIndices(mBase->getIndices());
+   mesh->setNormals(mBase->getNormals());
+   mesh->setTexcoords(mBase->getTexcoords());
+
+   for (int i=1; i<=level; i++)
+   {
+      Mesh* fine= subdivideSmooth(mesh);
+      delete mesh;
+      mesh= fine;
+
+      if (i <= getLevelCount())
+         applyDisplacements(mesh, mLevels[i - 1]);
+   }
+
+   if (level > 0)
+      mesh->calcVertexNormals();
+
+   return mesh;
+}
+
+
+Mesh* MultiresMesh::subdivideSmooth(const Mesh* mesh) const
+{
+   Mesh* fine= new Mesh();
+   fine->subDivide(mesh);
+   fine->calcVertexNormals();
+   return fine;
+}
+
+
+void MultiresMesh::applyDisplacements(Mesh* mesh, const Level& level) const
+{
+   const int count= level.mIndices.size();
+   if (count == 0)
+      return;
+
+   // frames are taken from the smooth surface before anything moves
+   Array<Vector3> offsets(count, true);
+   for (int i=0; i<count; i++)
+   {
+      Vector3 tangent, bitangent, normal;
+      const Vector3& d= level.mDisplacements[i];
+      getFrame(mesh, level.mIndices[i], tangent, bitangent, normal);
+      offsets[i]= tangent * d.x + bitangent * d.y + normal * d.z;
+   }
+
+   Vector3* vtx= mesh->getVertexData();
+   for (int i=0; i<count; i++)
+      vtx[ level.mIndices[i] ]+= offsets[i];
+}
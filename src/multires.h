@@ -0,0 +1,57 @@
+/*
+ multiresolution mesh: a base cage plus sparse displacements per subdivision level
+
+ level k is evaluated by subdividing level k-1 and moving some of its vertices.
+ displacements are stored in the local frame of the smooth subdivided surface:
+ x: tangent towards the vertex' first edge neighbour, y: bitangent, z: normal.
+ vertices closer to the smooth surface than the given tolerance are not stored at all.
+
+ levels are independent blocks of data, a level can be loaded or dropped on its own.
+ a level without displacements evaluates to the smooth subdivision surface.
+*/
+
+#pragma once
+
+#include "array.h"
+#include "mesh.h"
+#include "vector3.h"
+
+class MultiresMesh
+{
+public:
+   //! base cage is shared, not copied
+   MultiresMesh(const Mesh* base);
+
+   const Mesh* getBase() const;
+
+   //! number of levels above the base cage
+   int getLevelCount() const;
+   void setLevelCount(int count);
+
+   //! store sculpted vertex positions of "level" (level 1..getLevelCount()+1)
+   //! returns the number of stored displacements
+   int encode(int level, const Array<Vector3>& sculpted, float eps);
+
+   //! direct access to the displacements of a level (level 1..getLevelCount())
+   void setDisplacements(int level, const Array<int>& vertexIndices, const Array<Vector3>& displacements);
+   const Array<int>& getDisplacementIndices(int level) const;
+   const Array<Vector3>& getDisplacements(int level) const;
+   void clearDisplacements(int level);
+
+   //! create the mesh of the given level, owned by the caller
+   Mesh* evaluate(int level) const;
+
+private:
+   class Level
+   {
+   public:
+      Array<int>     mIndices;        //!< displaced vertices
+      Array<Vector3> mDisplacements;  //!< (tangent, bitangent, normal) offsets
+   };
+
+   Mesh* subdivideSmooth(const Mesh* mesh) const;
+   void  applyDisplacements(Mesh* mesh, const Level& level) const;
+
+   const Mesh*  mBase;
+   Array<Level> mLevels; //!< mLevels[0] is level 1
+};
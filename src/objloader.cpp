@@ -1,7 +1,9 @@
 #include "mesh.h"
+#include "smallarray.h"
 #include <QQueue>
 #include <QFile>
 #include <QMap>
+#include <utility>
 
 // a set of vertex indices (position, normal, uv)
 class IndexSet
@@ -36,6 +38,7 @@ public:
 
 Mesh* loadObj(const char* filename)
 {
+   ArrayStatistics::Scope statistics("obj loader");
    Mesh* mesh= 0;
    QQueue<Vector3> vertexQueue;
    QQueue<Vector3> normalQueue;
@@ -113,7 +116,7 @@ Mesh* loadObj(const char* filename)
       // face: v/vt/vn v/vt/vn v/vt/vn ...
       else if (line.startsWith(faceId))
       {
-         Array<IndexSet> poly(16);  // typically n-gons with n=3,4,5
+         SmallArray<IndexSet, 8> poly;  // typically n-gons with n=3,4,5
 
          int size= line.size();
          while (start < size)
@@ -239,10 +242,10 @@ Mesh* loadObj(const char* filename)
 
    if (mesh)
    {
-      mesh->setIndices( uniqueIndices );
-      mesh->setVertices( uniqueVertices );
-      mesh->setNormals( uniqueNormals );
-      mesh->setTexcoords( uniqueTexcoords );
+      mesh->setIndices( std::move(uniqueIndices) );
+      mesh->setVertices( std::move(uniqueVertices) );
+      mesh->setNormals( std::move(uniqueNormals) );
+      mesh->setTexcoords( std::move(uniqueTexcoords) );
    }
 
    return mesh;
@@ -0,0 +1,43 @@
+#include "parallel.h"
+#include <atomic>
+
+// read by parallel loops on any thread, so it is atomic
+static std::atomic<int> threadCount(0); // 0: not initialized yet
+
+
+int getThreadCount()
+{
+   int current= threadCount.load(std::memory_order_relaxed);
+   if (current > 0)
+      return current;
+
+   int count= (int)std::thread::hardware_concurrency();
+   if (count <= 0)
+      count= 1;
+
+   // a concurrent setThreadCount() wins over the default
+   if (!threadCount.compare_exchange_strong(current, count, std::memory_order_relaxed) && current > 0)
+      return current;
+   return count;
+}
+
+
+void setThreadCount(int count)
+{
+   threadCount.store(count, std::memory_order_relaxed);
+}
+
+
+int getChunkCount(int count, int grain)
+{
+   if (grain < 1)
+      grain= 1;
+
+   int chunkCount= (count + grain - 1) / grain;
+   const int threads= getThreadCount();
+   if (chunkCount > threads)
+      chunkCount= threads;
+   if (chunkCount < 1)
+      chunkCount= 1;
+   return chunkCount;
+}
@@ -0,0 +1,65 @@
+/*
+ fork/join helper for data parallel loops
+
+ parallelFor() splits [0, count) into contiguous chunks and runs each chunk
+ on its own thread, the calling thread handles the first chunk.
+ chunk boundaries only depend on count, grain and the thread count,
+ so per-chunk results (counts, partial sums) can be combined in chunk order
+ to get the same result as a serial loop.
+
+ usage:
+ parallelFor(count, [&](int begin, int end, int chunk) { ... });
+*/
+
+#pragma once
+
+#include <thread>
+
+//! number of threads used by parallelFor() (default: number of cores)
+int getThreadCount();
+
+//! limit the number of threads, 1 runs everything on the calling thread
+void setThreadCount(int count);
+
+//! number of chunks parallelFor() uses for "count" items
+int getChunkCount(int count, int grain= 4096);
+
+//! chunks with enough items start at a multiple of this, with cache line aligned arrays
+//! (see Allocator) neighbouring chunks of 4, 8, 12 or 16 byte items never share a cache line
+static const int sChunkAlignment= 16;
+
+//! first item of the given chunk
+inline int getChunkBegin(int count, int chunkCount, int chunk)
+{
+   const int begin= (int)(((long long)count * chunk) / chunkCount);
+   if (chunk >= chunkCount || count < chunkCount * sChunkAlignment * 4)
+      return begin;
+   return begin & ~(sChunkAlignment - 1);
+}
+
+//! call function(begin, end, chunk) for all chunks of [0, count)
+template <class Function> void parallelFor(int count, Function function, int grain= 4096)
+{
+   const int chunkCount= getChunkCount(count, grain);
+
+   if (chunkCount <= 1)
+   {
+      if (count > 0)
+         function(0, count, 0);
+      return;
+   }
+
+   std::thread* threads= new std::thread[chunkCount - 1];
+   for (int chunk=1; chunk<chunkCount; chunk++)
+   {
+      const int begin= getChunkBegin(count, chunkCount, chunk);
+      const int end= getChunkBegin(count, chunkCount, chunk + 1);
+      threads[chunk - 1]= std::thread(function, begin, end, chunk);
+   }
+
+   function(0, getChunkBegin(count, chunkCount, 1), 0);
+
+   for (int i=0; i<chunkCount-1; i++)
+      threads[i].join();
+   delete[] threads;
+}
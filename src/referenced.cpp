@@ -1,7 +1,7 @@
 #include "referenced.h"
 
 Referenced::Referenced()
-: mReferences(new int(1))
+: mReferences(0)
 {
 }
 
@@ -19,24 +19,23 @@ Referenced::Referenced(const Referenced* r)
 
 Referenced::~Referenced()
 {
-   if (!deref())
-   {
-      if (mReferences)
-      {
-         delete mReferences;
-         mReferences= 0;
-      }
-   }
+   // the counter belongs to the storage of the derived class
 }
 
 void Referenced::addRef() const
 {
-   int count= (*mReferences) + 1;
-   *mReferences = count;
+   if (mReferences)
+   {
+      int count= (*mReferences) + 1;
+      *mReferences = count;
+   }
 }
 
 bool Referenced::deref()
 {
+   if (!mReferences)
+      return false;
+
    int count= (*mReferences) - 1;
    *mReferences = count;
    return (count!=0);
@@ -44,23 +43,87 @@ bool Referenced::deref()
 
 bool Referenced::copyRef()
 {
-   if (*mReferences > 1)
+   if (mReferences && *mReferences > 1)
    {
       *mReferences = (*mReferences)-1;
-      mReferences= new int(1);
+      mReferences= 0;
       return true;
    }
    else
       return false;
 }
 
-int Referenced::getRefCount() const
+Referenced::Counter* Referenced::getRef() const
+{
+   return mReferences;
+}
+
+void Referenced::setRef(Counter* counter)
 {
-   return *mReferences;
+   mReferences= counter;
 }
 
-int* Referenced::getRef() const
+
+
+AtomicReferenced::AtomicReferenced()
+: mReferences(0)
+{
+}
+
+AtomicReferenced::AtomicReferenced(const AtomicReferenced& r)
+: mReferences( r.getRef() )
+{
+   addRef();
+}
+
+AtomicReferenced::AtomicReferenced(const AtomicReferenced* r)
+: mReferences( r->getRef() )
+{
+   addRef();
+}
+
+AtomicReferenced::~AtomicReferenced()
+{
+   // the counter belongs to the storage of the derived class
+}
+
+void AtomicReferenced::addRef() const
+{
+   // a new reference is always made from an existing one, no ordering needed
+   if (mReferences)
+      mReferences->fetch_add(1, std::memory_order_relaxed);
+}
+
+bool AtomicReferenced::deref()
+{
+   if (!mReferences)
+      return false;
+
+   return (mReferences->fetch_sub(1, std::memory_order_acq_rel) != 1);
+}
+
+bool AtomicReferenced::copyRef()
+{
+   if (mReferences && mReferences->load(std::memory_order_acquire) > 1)
+   {
+      if (mReferences->fetch_sub(1, std::memory_order_acq_rel) > 1)
+      {
+         mReferences= 0;
+         return true;
+      }
+
+      // the other references were dropped meanwhile, the data is ours again
+      mReferences->store(1, std::memory_order_relaxed);
+   }
+   return false;
+}
+
+AtomicReferenced::Counter* AtomicReferenced::getRef() const
 {
    return mReferences;
 }
 
+void AtomicReferenced::setRef(Counter* counter)
+{
+   mReferences= counter;
+}
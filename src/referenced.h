@@ -1,21 +1,72 @@
+/*
+ reference counting policies for Array
+
+ the counter itself is stored by the derived class, Array keeps it in a header directly
+ in front of its items so data and counter share one allocation. an object without
+ a counter (e.g. an empty array) is the only owner of nothing, its count is 1.
+*/
+
 #pragma once
 
+#include <atomic>
+
 class Referenced
 {
 public:
+   typedef int Counter;
+
    Referenced();
    Referenced(const Referenced& r);
    Referenced(const Referenced* r);
-   Referenced(Referenced* r);
    virtual ~Referenced();
 
    void addRef() const;       //! add reference
    bool deref();              //! remove reference
-   bool copyRef();            //! copy reference if required
+   bool copyRef();            //! drop a shared counter, the caller has to attach a new one
 
-   int getRefCount() const;  //! get number of referencing objects
-   int* getRef() const;       //! get reference pointer
+   inline int getRefCount() const;  //! get number of referencing objects
+   Counter* getRef() const;   //! get reference pointer
 
 protected:
-   int *mReferences;
+   void setRef(Counter* counter);  //! attach a counter, it is not owned
+
+   Counter *mReferences;
 };
+
+
+//! same interface with an atomic counter, references may live in different threads
+//! increments are relaxed, decrements acquire-release so the last owner sees all writes
+class AtomicReferenced
+{
+public:
+   typedef std::atomic<int> Counter;
+
+   AtomicReferenced();
+   AtomicReferenced(const AtomicReferenced& r);
+   AtomicReferenced(const AtomicReferenced* r);
+   virtual ~AtomicReferenced();
+
+   void addRef() const;       //! add reference
+   bool deref();              //! remove reference
+   bool copyRef();            //! drop a shared counter, the caller has to attach a new one
+
+   inline int getRefCount() const;  //! get number of referencing objects
+   Counter* getRef() const;   //! get reference pointer
+
+protected:
+   void setRef(Counter* counter);  //! attach a counter, it is not owned
+
+   Counter *mReferences;
+};
+
+
+// inline, Array checks the count on every write
+int Referenced::getRefCount() const
+{
+   return mReferences ? *mReferences : 1;
+}
+
+int AtomicReferenced::getRefCount() const
+{
+   return mReferences ? mReferences->load(std::memory_order_acquire) : 1;
+}
@@ -0,0 +1,398 @@
+// quadric error edge collapse
+
+#include "simplification.h"
+#include "topology.h"
+
+
+// symmetric 4x4 matrix of the plane equations (a,b,c,d)
+class Quadric
+{
+public:
+   double a2, ab, ac, ad;
+   double     b2, bc, bd;
+   double         c2, cd;
+   double             d2;
+
+   void init(const Vector3& n, float d)
+   {
+      a2= n.x*n.x; ab= n.x*n.y; ac= n.x*n.z; ad= n.x*d;
+      b2= n.y*n.y; bc= n.y*n.z; bd= n.y*d;
+      c2= n.z*n.z; cd= n.z*d;
+      d2= (double)d*d;
+   }
+
+   void operator += (const Quadric& q)
+   {
+      a2+= q.a2; ab+= q.ab; ac+= q.ac; ad+= q.ad;
+      b2+= q.b2; bc+= q.bc; bd+= q.bd;
+      c2+= q.c2; cd+= q.cd;
+      d2+= q.d2;
+   }
+
+   // sum of squared distances of v to the planes
+   float evaluate(const Vector3& v) const
+   {
+      const double x= v.x, y= v.y, z= v.z;
+      return (float)(
+           a2*x*x + 2.0*ab*x*y + 2.0*ac*x*z + 2.0*ad*x
+         + b2*y*y + 2.0*bc*y*z + 2.0*bd*y
+         + c2*z*z + 2.0*cd*z
+         + d2 );
+   }
+};
+
+
+// heap entry: move vertex "from" onto vertex "to"
+class Collapse
+{
+public:
+   float mCost;
+   int   mFrom;
+   int   mTo;
+   int   mFromStamp;  //!< versions of both vertices when the entry was pushed
+   int   mToStamp;
+};
+
+
+// min-heap on mCost
+static void heapPush(Array<Collapse>& heap, const Collapse& item)
+{
+   int i= heap.add(item);
+   Collapse* data= heap.data();
+   while (i > 0)
+   {
+      const int parent= (i - 1) / 2;
+      if (data[parent].mCost <= data[i].mCost)
+         break;
+
+      const Collapse t= data[parent];
+      data[parent]= data[i];
+      data[i]= t;
+      i= parent;
+   }
+}
+
+static Collapse heapPop(Array<Collapse>& heap)
+{
+   Collapse* data= heap.data();
+   const Collapse top= data[0];
+   const Collapse last= heap.takeLast();
+   const int count= heap.size();
+   if (count == 0)
+      return top;
+
+   int i= 0;
+   data[0]= last;
+   for (;;)
+   {
+      int child= i * 2 + 1;
+      if (child >= count)
+         break;
+      if (child + 1 < count && data[child+1].mCost < data[child].mCost)
+         child++;
+      if (data[i].mCost <= data[child].mCost)
+         break;
+
+      const Collapse t= data[child];
+      data[child]= data[i];
+      data[i]= t;
+      i= child;
+   }
+
+   return top;
+}
+
+
+// state of one simplification run, all in flat per-vertex/per-triangle arrays
+class Simplifier
+{
+public:
+   Simplifier(const Array<Vector3>& vertices, const Array<int>& indices, const Topology& topology);
+
+   void run(int targetTriangles, float maxError);
+   void getIndices(Array<int>& dstIndices) const;
+
+private:
+   // call f(triangle) for all remaining triangles around the collapsed vertex group of v
+   template <class F> void forEachTriangle(int v, F f) const
+   {
+      int member= v;
+      do
+      {
+         const int* corners= mTopology.getCorners(member);
+         const int count= mTopology.getCornerCount(member);
+         for (int i=0; i<count; i++)
+         {
+            const int triangle= corners[i] / 3;
+            if (!mRemoved[triangle])
+               f(triangle);
+         }
+         member= mGroupNext[member];
+      }
+      while (member != v);
+   }
+
+   void pushEdge(int v1, int v2);
+   void pushEdges(int v);
+   bool isValid(int from, int to);
+   void collapse(int from, int to);
+
+   const Vector3*   mVertices;
+   const Topology&  mTopology;
+   int              mTriangleCount;
+   int              mPass = 0;
+   Array<int>       mIndices;     //!< triangles, corners always refer to the surviving vertex
+   Array<bool>      mRemoved;     //!< per triangle
+   Array<Quadric>   mQuadrics;    //!< per vertex
+   Array<bool>      mLocked;      //!< per vertex: boundary vertices do not move
+   Array<int>       mStamps;      //!< per vertex: incremented whenever the vertex changes
+   Array<int>       mGroupNext;   //!< per vertex: circular list of the vertices collapsed into each other
+   Array<int>       mMarks;       //!< per vertex: neighbour marks, compared against mPass
+   Array<Collapse>  mHeap;
+};
+
+
+Simplifier::Simplifier(const Array<Vector3>& vertices, const Array<int>& indices, const Topology& topology)
+ : mVertices(vertices.data())
+ , mTopology(topology)
+ , mTriangleCount(indices.size() / 3)
+{
+   int i;
+   const int numVerts= vertices.size();
+
+   mIndices.copy(indices);
+   mRemoved.init(mTriangleCount, true);
+   memset(mRemoved.data(), 0, mTriangleCount * sizeof(bool));
+
+   mQuadrics.init(numVerts, true);
+   memset(mQuadrics.data(), 0, numVerts * sizeof(Quadric));
+
+   mLocked.init(numVerts, true);
+   mStamps.init(numVerts, true);
+   mGroupNext.init(numVerts, true);
+   mMarks.init(numVerts, true);
+   for (i=0; i<numVerts; i++)
+   {
+      mLocked[i]= topology.isBoundaryVertex(i);
+      mStamps[i]= 0;
+      mGroupNext[i]= i;
+      mMarks[i]= 0;
+   }
+
+   // plane of every triangle goes to its three corners
+   const int* idx= mIndices.data();
+   for (i=0; i<mTriangleCount; i++)
+   {
+      const Vector3& v1= mVertices[ idx[i*3] ];
+      Vector3 n= (mVertices[ idx[i*3+1] ] - v1) % (mVertices[ idx[i*3+2] ] - v1);
+      if (n.length2() <= 0.0f)
+         continue;
+
+      n.normalize();
+      Quadric q;
+      q.init(n, -(n * v1));
+      mQuadrics[ idx[i*3] ]+= q;
+      mQuadrics[ idx[i*3+1] ]+= q;
+      mQuadrics[ idx[i*3+2] ]+= q;
+   }
+
+   for (i=0; i<topology.getEdgeCount(); i++)
+      pushEdge(topology.getEdgeVertex(i, 0), topology.getEdgeVertex(i, 1));
+}
+
+
+void Simplifier::pushEdge(int v1, int v2)
+{
+   // collapse onto the cheaper end, boundary vertices only receive collapses
+   Quadric q= mQuadrics[v1];
+   q+= mQuadrics[v2];
+
+   Collapse c;
+   c.mFrom= -1;
+   if (!mLocked[v1])
+   {
+      c.mCost= q.evaluate(mVertices[v2]);
+      c.mFrom= v1;
+      c.mTo= v2;
+   }
+
+   if (!mLocked[v2])
+   {
+      const float cost= q.evaluate(mVertices[v1]);
+      if (c.mFrom < 0 || cost < c.mCost)
+      {
+         c.mCost= cost;
+         c.mFrom= v2;
+         c.mTo= v1;
+      }
+   }
+
+   if (c.mFrom < 0)
+      return;
+
+   c.mFromStamp= mStamps[c.mFrom];
+   c.mToStamp= mStamps[c.mTo];
+   heapPush(mHeap, c);
+}
+
+
+void Simplifier::pushEdges(int v)
+{
+   const int pass= ++mPass;
+   const int* idx= mIndices.data();
+   forEachTriangle(v, [&](int triangle)
+   {
+      for (int i=0; i<3; i++)
+      {
+         const int w= idx[triangle*3+i];
+         if (w != v && mMarks[w] != pass)
+         {
+            mMarks[w]= pass;
+            pushEdge(v, w);
+         }
+      }
+   });
+}
+
+
+bool Simplifier::isValid(int from, int to)
+{
+   const int* idx= mIndices.data();
+   const Vector3& target= mVertices[to];
+
+   // mark the neighbours of "from", count the triangles on the edge
+   const int pass= ++mPass;
+   int shared= 0;
+   bool flipped= false;
+   forEachTriangle(from, [&](int triangle)
+   {
+      const int* t= idx + triangle*3;
+      if (t[0] == to || t[1] == to || t[2] == to)
+      {
+         shared++;
+      }
+      else
+      {
+         // the triangle must not turn over when "from" moves onto "to"
+         Vector3 p[3];
+         for (int i=0; i<3; i++)
+            p[i]= mVertices[ t[i] ];
+         const Vector3 before= (p[1] - p[0]) % (p[2] - p[0]);
+         for (int i=0; i<3; i++)
+         {
+            if (t[i] == from)
+               p[i]= target;
+         }
+         const Vector3 after= (p[1] - p[0]) % (p[2] - p[0]);
+         if (before * after <= 0.0f)
+            flipped= true;
+      }
+
+      for (int i=0; i<3; i++)
+         mMarks[ t[i] ]= pass;
+   });
+
+   if (flipped || shared == 0)
+      return false;
+
+   // link condition: the edge's triangles are the only ones joining both fans
+   int common= 0;
+   forEachTriangle(to, [&](int triangle)
+   {
+      for (int i=0; i<3; i++)
+      {
+         const int w= idx[triangle*3+i];
+         if (w != from && w != to && mMarks[w] == pass)
+         {
+            mMarks[w]= 0;
+            common++;
+         }
+      }
+   });
+
+   return common == shared;
+}
+
+
+void Simplifier::collapse(int from, int to)
+{
+   int* idx= mIndices.data();
+   forEachTriangle(from, [&](int triangle)
+   {
+      int* t= idx + triangle*3;
+      if (t[0] == to || t[1] == to || t[2] == to)
+      {
+         mRemoved[triangle]= true;
+         mTriangleCount--;
+      }
+      else
+      {
+         for (int i=0; i<3; i++)
+         {
+            if (t[i] == from)
+               t[i]= to;
+         }
+      }
+   });
+
+   mQuadrics[to]+= mQuadrics[from];
+
+   // join both circular lists
+   const int next= mGroupNext[from];
+   mGroupNext[from]= mGroupNext[to];
+   mGroupNext[to]= next;
+
+   // outdate all heap entries of both vertices
+   mStamps[from]++;
+   mStamps[to]++;
+   pushEdges(to);
+}
+
+
+void Simplifier::run(int targetTriangles, float maxError)
+{
+   while (mTriangleCount > targetTriangles && !mHeap.isEmpty())
+   {
+      const Collapse c= heapPop(mHeap);
+      if (c.mFromStamp != mStamps[c.mFrom] || c.mToStamp != mStamps[c.mTo])
+         continue;
+
+      if (c.mCost > maxError)
+         break;
+
+      if (isValid(c.mFrom, c.mTo))
+         collapse(c.mFrom, c.mTo);
+   }
+}
+
+
+void Simplifier::getIndices(Array<int>& dstIndices) const
+{
+   dstIndices.init(mTriangleCount * 3, true);
+
+   const int numTriangles= mRemoved.size();
+   int* dst= dstIndices.data();
+   for (int i=0; i<numTriangles; i++)
+   {
+      if (mRemoved[i])
+         continue;
+
+      *dst++= mIndices[i*3];
+      *dst++= mIndices[i*3+1];
+      *dst++= mIndices[i*3+2];
+   }
+}
+
+
+void simplifyTriangles(
+      Array<int>& dstIndices,
+      const Array<Vector3>& vertices,
+      const Array<int>& srcIndices,
+      const Topology& topology,
+      int targetTriangles,
+      float maxError )
+{
+   Simplifier simplifier(vertices, srcIndices, topology);
+   simplifier.run(targetTriangles, maxError);
+   simplifier.getIndices(dstIndices);
+}
@@ -0,0 +1,36 @@
+/*
+ quadric error mesh simplification (garland & heckbert)
+
+ every vertex accumulates the planes of its triangles in a quadric, the error of
+ moving it somewhere is the sum of squared distances to these planes.
+ the cheapest edge collapse is taken from a heap again and again until the target
+ triangle count is reached or the next collapse would exceed the error bound.
+
+ an edge collapses onto one of its two vertices, so surviving vertices keep their
+ positions, normals and uvs. vertices on boundary edges never move. this keeps open
+ borders and uv seams intact: the obj loader splits vertices along seams, which
+ turns every seam into a pair of boundaries.
+
+ collapses that flip a triangle or pinch the surface (link condition) are rejected.
+ heap entries are not removed when a vertex changes, they carry version stamps of
+ both vertices and are skipped once they are outdated.
+*/
+
+#pragma once
+
+#include "array.h"
+#include "vector3.h"
+
+class Topology;
+
+// simplify the triangles (srcIndices) down to targetTriangles,
+// stop early once a collapse would cost more than maxError (squared distance).
+// dstIndices refers to the same vertices, collapsed vertices are no longer used
+void simplifyTriangles(
+   Array<int>& dstIndices,
+   const Array<Vector3>& vertices,
+   const Array<int>& srcIndices,
+   const Topology& topology,
+   int targetTriangles,
+   float maxError
+);
@@ -0,0 +1,191 @@
+#include "skinning.h"
+#include "parallel.h"
+
+
+void Skinning::setBindPose(const Array<Vector3>& vertices)
+{
+   mBindPose= vertices;
+   buildVertexMorphs();
+}
+
+
+int Skinning::getVertexCount() const
+{
+   return mBindPose.size();
+}
+
+
+void Skinning::setInfluences(const Array<int>& bones, const Array<float>& weights)
+{
+   mBones= bones;
+   mWeights= weights;
+}
+
+
+void Skinning::setBoneTransforms(const Matrix3x4* transforms, int count)
+{
+   if (mBoneTransforms.size() != count)
+      mBoneTransforms.init(count, true);
+   memcpy(mBoneTransforms.data(), transforms, count * sizeof(Matrix3x4));
+}
+
+
+int Skinning::addMorphTarget(const Array<int>& vertexIndices, const Array<Vector3>& deltas)
+{
+   const int count= vertexIndices.size();
+   if (deltas.size() != count)
+      return -1;
+
+   // each vertex may appear only once per target
+   const int numVerts= mBindPose.size();
+   Array<unsigned char> used(numVerts, true);
+   if (numVerts > 0)
+      memset(used.data(), 0, numVerts);
+   for (int i=0; i<count; i++)
+   {
+      const int v= vertexIndices[i];
+      if (v < 0 || v >= numVerts || used[v])
+         return -1;
+      used[v]= 1;
+   }
+
+   if (mMorphOffsets.isEmpty())
+      mMorphOffsets.add(0);
+
+   const int target= mMorphWeights.size();
+   mMorphIndices.add(vertexIndices);
+   mMorphDeltas.add(deltas);
+   mMorphOffsets.add(mMorphIndices.size());
+   for (int i=0; i<count; i++)
+      mMorphTargets.add(target);
+   buildVertexMorphs();
+   return mMorphWeights.add(0.0f);
+}
+
+
+void Skinning::buildVertexMorphs()
+{
+   int i;
+   const int numVerts= mBindPose.size();
+   const int numEntries= mMorphIndices.size();
+   const int* indices= mMorphIndices.data();
+
+   // counting sort of the entries by vertex. entries are stored target by target,
+   // so the entries of each vertex stay in target order
+   mVertexMorphOffsets.init(numVerts + 1, true);
+   int* offsets= mVertexMorphOffsets.data();
+   memset(offsets, 0, (numVerts + 1) * sizeof(int));
+   for (i=0; i<numEntries; i++)
+   {
+      if (indices[i] < numVerts)
+         offsets[ indices[i] + 1 ]++;
+   }
+   for (i=0; i<numVerts; i++)
+      offsets[i+1]+= offsets[i];
+
+   mVertexMorphEntries.init(offsets[numVerts], true);
+   Array<int> fill(numVerts, true);
+   if (numVerts > 0)
+      memcpy(fill.data(), offsets, numVerts * sizeof(int));
+   for (i=0; i<numEntries; i++)
+   {
+      if (indices[i] < numVerts)
+         mVertexMorphEntries[ fill[indices[i]]++ ]= i;
+   }
+}
+
+
+int Skinning::getMorphTargetCount() const
+{
+   return mMorphWeights.size();
+}
+
+
+void Skinning::setMorphWeight(int target, float weight)
+{
+   mMorphWeights[target]= weight;
+}
+
+
+void Skinning::deform(Span<Vector3> dstVertices) const
+{
+   dstVertices= dstVertices.slice(0, mBindPose.size());
+   const Span<const Vector3> bindPose(mBindPose);
+
+   // a single pass over the vertices does all stages, whatever the number of targets
+   parallelFor(dstVertices, [&](Span<Vector3> vertices, int begin, int /*chunk*/)
+   {
+      copySpan(vertices, bindPose.slice(begin, begin + vertices.size()));
+
+      if (!mVertexMorphEntries.isEmpty())
+         applyMorphTargets(vertices, begin);
+
+      if (!mWeights.isEmpty())
+         applySkinning(vertices, begin);
+   });
+}
+
+
+void Skinning::applyMorphTargets(Span<Vector3> vertices, int begin) const
+{
+   const int* offsets= mVertexMorphOffsets.data();
+   const int* entries= mVertexMorphEntries.data();
+   const int* targets= mMorphTargets.data();
+   const Vector3* deltas= mMorphDeltas.data();
+   const float* weights= mMorphWeights.data();
+
+   for (int i=0; i<vertices.size(); i++)
+   {
+      const int v= begin + i;
+      const int end= offsets[v+1];
+      if (offsets[v] == end)
+         continue;
+
+      // targets are added in order, like a loop over the targets would
+      Vector3 p= vertices[i];
+      for (int k=offsets[v]; k<end; k++)
+      {
+         const int entry= entries[k];
+         const float weight= weights[ targets[entry] ];
+         if (weight != 0.0f)
+            p+= deltas[entry] * weight;
+      }
+      vertices[i]= p;
+   }
+}
+
+
+void Skinning::applySkinning(Span<Vector3> vertices, int begin) const
+{
+   const int* bones= mBones.data();
+   const float* weights= mWeights.data();
+   const Matrix3x4* transforms= mBoneTransforms.data();
+
+   for (int i=0; i<vertices.size(); i++)
+   {
+      const int v= begin + i;
+
+      // blend the bone matrices first, then transform once
+      // the 12 float loops are straight multiply-adds the compiler maps onto simd registers
+      float m[12]= {0,0,0,0, 0,0,0,0, 0,0,0,0};
+      const int* bone= bones + v * sMaxInfluences;
+      const float* weight= weights + v * sMaxInfluences;
+      for (int k=0; k<sMaxInfluences; k++)
+      {
+         const float w= weight[k];
+         if (w == 0.0f)
+            continue;
+
+         const float* src= transforms[ bone[k] ].m;
+         for (int j=0; j<12; j++)
+            m[j]+= src[j] * w;
+      }
+
+      const Vector3 p= vertices[i];
+      vertices[i]= Vector3(
+         m[0]*p.x + m[1]*p.y + m[2]*p.z  + m[3],
+         m[4]*p.x + m[5]*p.y + m[6]*p.z  + m[7],
+         m[8]*p.x + m[9]*p.y + m[10]*p.z + m[11]
+      );
+   }
+}
@@ -0,0 +1,78 @@
+/*
+ deforms the positions of a subdivision cage every frame
+
+ 1) sparse morph targets are added to the bind pose:
+    p = bind + sum(weight[t] * delta[t])
+ 2) linear blend skinning with up to 4 bones per vertex:
+    p' = sum(boneWeight[i] * boneTransform[bone[i]]) * p
+
+ the result is written into a caller supplied buffer which can be passed
+ straight on to loopSubdivisionVertices() together with the cage's indices and topology:
+
+ skinning.deform(cage);
+ loopSubdivisionVertices(level1, cage, cageIndices, cageTopology);
+ loopSubdivisionVertices(level2, level1, level1Indices, level1Topology);
+*/
+
+#pragma once
+
+#include "array.h"
+#include "span.h"
+#include "vector3.h"
+
+// affine bone transform, 3 rows of (rotation/scale | translation)
+struct Matrix3x4
+{
+   float m[12];
+};
+
+class Skinning
+{
+public:
+   static const int sMaxInfluences= 4; //!< bones per vertex
+
+   Skinning() = default;
+
+   //! cage positions without any deformation
+   void setBindPose(const Array<Vector3>& vertices);
+   int getVertexCount() const;
+
+   //! sMaxInfluences bone indices and weights per vertex, unused slots have weight 0
+   void setInfluences(const Array<int>& bones, const Array<float>& weights);
+
+   //! bone transforms from bind pose to current pose
+   void setBoneTransforms(const Matrix3x4* transforms, int count);
+
+   //! add a morph target: deltas[i] moves vertex vertexIndices[i], returns target index
+   //! -1 if the lists differ in length or an index is repeated or not in the bind pose
+   //! (set the bind pose first)
+   int addMorphTarget(const Array<int>& vertexIndices, const Array<Vector3>& deltas);
+   int getMorphTargetCount() const;
+   void setMorphWeight(int target, float weight);
+
+   //! write deformed positions (getVertexCount() elements) to dstVertices
+   //! all stages run in one parallel pass over the vertices
+   void deform(Span<Vector3> dstVertices) const;
+
+private:
+   // per vertex entry lists, rebuilt whenever the bind pose or the targets change
+   void buildVertexMorphs();
+
+   // deform the chunk of vertices starting at vertex "begin" in place
+   void applyMorphTargets(Span<Vector3> vertices, int begin) const;
+   void applySkinning(Span<Vector3> vertices, int begin) const;
+
+   // morph targets are stored back to back, target t uses entries
+   // mMorphOffsets[t] .. mMorphOffsets[t+1]-1
+   Array<Vector3>   mBindPose;        //!< undeformed cage positions
+   Array<int>       mBones;           //!< sMaxInfluences bone indices per vertex
+   Array<float>     mWeights;         //!< sMaxInfluences bone weights per vertex
+   Array<Matrix3x4> mBoneTransforms;  //!< current pose
+   Array<int>       mMorphOffsets;    //!< first entry of each target (+1 end marker)
+   Array<int>       mMorphIndices;    //!< vertex index per entry
+   Array<Vector3>   mMorphDeltas;     //!< position offset per entry
+   Array<int>       mMorphTargets;    //!< target per entry
+   Array<float>     mMorphWeights;    //!< weight per target
+   Array<int>       mVertexMorphOffsets;  //!< first mVertexMorphEntries item of each vertex (+1 end marker)
+   Array<int>       mVertexMorphEntries;  //!< entries grouped by vertex, in target order
+};
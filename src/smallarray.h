@@ -0,0 +1,212 @@
+/*
+ growable array with room for N items inside the object
+
+ meant for short lists built in hot loops (the corners of a face, the faces
+ around a vertex): as long as at most N items are stored no memory is allocated.
+ the N+1st item moves the list to the heap, which doubles like Array.
+
+ unlike Array there is no reference counting, copies are deep.
+ the inline items are default-constructed with the object.
+
+ usage:
+ SmallArray<int, 8> list;
+ list.add(...) items
+ list[..] item from the list
+*/
+
+#pragma once
+
+#include "array.h"
+
+template <class Item, int N>
+class SmallArray
+{
+public:
+   SmallArray();
+   SmallArray(const SmallArray& a);
+   ~SmallArray();
+
+   SmallArray& operator = (const SmallArray& a);
+
+   inline Item& operator[](int index)
+   {
+      return mData[index];
+   }
+
+   inline const Item& operator[](int index) const
+   {
+      return mData[index];
+   }
+
+   //! add item, returns its index
+   int add(const Item& item);
+
+   //! get last element
+   const Item& getLast() const;
+
+   //! get and remove last item
+   const Item& takeLast();
+
+   //! return index of element (-1 if not existing)
+   int indexOf(const Item& item) const;
+
+   //! return whether "item" exists in the list
+   bool contains(const Item& item) const;
+
+   //! erase item at given index. following items will be moved
+   void removeAt(int index);
+
+   //! remove all items, the capacity is kept
+   void clear();
+
+   //! make room for "capacity" items, existing items are kept
+   void reserve(int capacity);
+
+   Item* data();
+   const Item* data() const;
+
+   inline int size() const
+   {
+      return mCount;
+   }
+
+   bool isEmpty() const;
+   int capacity() const;
+
+   //! items are still stored inside the object
+   bool isInline() const;
+
+private:
+   typedef ArrayStorage<Item> Storage;
+
+   Item* mData;      // mInline or heap storage
+   int   mSize;      // capacity of mData
+   int   mCount;     // number of items
+   Item  mInline[N];
+};
+
+
+template <class Item, int N> SmallArray<Item, N>::SmallArray()
+: mData(mInline)
+, mSize(N)
+, mCount(0)
+{
+}
+
+template <class Item, int N> SmallArray<Item, N>::SmallArray(const SmallArray& a)
+: mData(mInline)
+, mSize(N)
+, mCount(0)
+{
+   *this= a;
+}
+
+template <class Item, int N> SmallArray<Item, N>::~SmallArray()
+{
+   if (mData != mInline)
+      Storage::release(Allocator::getHeap(), mData, mSize);
+}
+
+template <class Item, int N> SmallArray<Item, N>& SmallArray<Item, N>::operator = (const SmallArray& a)
+{
+   if (this != &a)
+   {
+      mCount= 0;
+      reserve(a.size());
+      Storage::copy(mData, a.data(), a.size());
+      mCount= a.size();
+   }
+   return *this;
+}
+
+template <class Item, int N> int SmallArray<Item, N>::add(const Item& item)
+{
+   if (mCount >= mSize)
+   {
+      // "item" may be stored in this list
+      const Item value= item;
+      reserve(mSize * 2);
+      mData[mCount]= value;
+   }
+   else
+   {
+      mData[mCount]= item;
+   }
+   return mCount++;
+}
+
+template <class Item, int N> const Item& SmallArray<Item, N>::getLast() const
+{
+   return mData[mCount-1];
+}
+
+template <class Item, int N> const Item& SmallArray<Item, N>::takeLast()
+{
+   mCount--;
+   return mData[mCount];
+}
+
+template <class Item, int N> int SmallArray<Item, N>::indexOf(const Item& item) const
+{
+   for (int index=0; index<mCount; index++)
+   {
+      if (mData[index] == item)
+         return index;
+   }
+   return -1;
+}
+
+template <class Item, int N> bool SmallArray<Item, N>::contains(const Item& item) const
+{
+   return indexOf(item) >= 0;
+}
+
+template <class Item, int N> void SmallArray<Item, N>::removeAt(int index)
+{
+   Storage::move(mData + index, mData + index + 1, mCount - index - 1);
+   mCount--;
+}
+
+template <class Item, int N> void SmallArray<Item, N>::clear()
+{
+   mCount= 0;
+}
+
+template <class Item, int N> void SmallArray<Item, N>::reserve(int capacity)
+{
+   if (capacity <= mSize)
+      return;
+
+   Item* temp= mData;
+   mData= Storage::allocate(Allocator::getHeap(), capacity);
+   Storage::copy(mData, temp, mCount);
+
+   if (temp != mInline)
+      Storage::release(Allocator::getHeap(), temp, mSize);
+   mSize= capacity;
+}
+
+template <class Item, int N> Item* SmallArray<Item, N>::data()
+{
+   return mData;
+}
+
+template <class Item, int N> const Item* SmallArray<Item, N>::data() const
+{
+   return mData;
+}
+
+template <class Item, int N> bool SmallArray<Item, N>::isEmpty() const
+{
+   return (mCount == 0);
+}
+
+template <class Item, int N> int SmallArray<Item, N>::capacity() const
+{
+   return mSize;
+}
+
+template <class Item, int N> bool SmallArray<Item, N>::isInline() const
+{
+   return (mData == mInline);
+}
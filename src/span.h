@@ -0,0 +1,191 @@
+/*
+ non-owning view of "count" items, e.g. a part of an Array handed to a worker
+
+ a span neither copies nor references the data: it holds a pointer, a count
+ and a stride, so splitting work does not touch any reference counter.
+ the viewed memory has to outlive the span. writing through a span of an
+ Array is like writing through Array::data(), shared data is not detached.
+
+ the stride is given in bytes, by default the items are contiguous.
+ with a larger stride a span views one attribute of interleaved data:
+   Span<const Vector2> uvs((const Vector2*)(vertices + uvOffset), count, vertexSize);
+
+ slice() and getChunk() clamp to the bounds of the span, operator[] does not check.
+ getChunk() uses the boundaries of parallelFor(), parallelFor(span, ...) hands
+ every worker its chunk as a span:
+   parallelFor(span, [&](Span<Vector3> chunk, int begin, int chunkIndex) { ... });
+
+ Span<const Item> is constructed from const arrays and from Span<Item>.
+*/
+
+#pragma once
+
+#include "array.h"
+#include "parallel.h"
+#include <string.h>
+#include <type_traits>
+
+template <class Item>
+class Span
+{
+public:
+   //! empty span
+   Span();
+
+   //! "count" items starting at "data", "stride" bytes apart
+   Span(Item* data, int count, int stride= sizeof(Item));
+
+   //! all items of "array", no reference is added
+   template <class References>
+   Span(const Array<typename std::remove_const<Item>::type, References>& array);
+
+   //! span of const items from a span of mutable items
+   template <class Other>
+   Span(const Span<Other>& span, typename std::enable_if<std::is_convertible<Other*, Item*>::value>::type* = 0);
+
+   inline Item& operator[](int index) const
+   {
+      return *(Item*)((Byte*)mData + (size_t)index * mStride);
+   }
+
+   //! first item
+   Item* data() const;
+
+   //! number of items
+   int size() const;
+   bool isEmpty() const;
+
+   //! bytes from one item to the next
+   int getStride() const;
+
+   //! items are packed without gaps
+   bool isContiguous() const;
+
+   //! items [begin, end), clamped to the span
+   Span slice(int begin, int end) const;
+
+   //! number of chunks parallelFor() uses for this span
+   int getChunkCount(int grain= 4096) const;
+
+   //! items of "chunk" out of "chunkCount", the same ranges parallelFor() passes
+   Span getChunk(int chunkCount, int chunk) const;
+
+private:
+   typedef typename std::conditional<std::is_const<Item>::value, const char, char>::type Byte;
+
+   Item* mData;    // first item
+   int   mCount;   // number of items
+   int   mStride;  // bytes between items
+};
+
+//! construct empty span
+template <class Item> Span<Item>::Span()
+: mData(0)
+, mCount(0)
+, mStride(sizeof(Item))
+{
+}
+
+//! construct span from pointer, count and stride
+template <class Item> Span<Item>::Span(Item* data, int count, int stride)
+: mData(data)
+, mCount(data ? count : 0)
+, mStride(stride)
+{
+}
+
+//! view of all items of an array
+template <class Item> template <class References> Span<Item>::Span(const Array<typename std::remove_const<Item>::type, References>& array)
+: mData(array.data())
+, mCount(array.size())
+, mStride(sizeof(Item))
+{
+}
+
+//! const view of a mutable span
+template <class Item> template <class Other> Span<Item>::Span(const Span<Other>& span, typename std::enable_if<std::is_convertible<Other*, Item*>::value>::type*)
+: mData(span.data())
+, mCount(span.size())
+, mStride(span.getStride())
+{
+}
+
+template <class Item> Item* Span<Item>::data() const
+{
+   return mData;
+}
+
+template <class Item> int Span<Item>::size() const
+{
+   return mCount;
+}
+
+template <class Item> bool Span<Item>::isEmpty() const
+{
+   return (mCount == 0);
+}
+
+template <class Item> int Span<Item>::getStride() const
+{
+   return mStride;
+}
+
+template <class Item> bool Span<Item>::isContiguous() const
+{
+   return (mStride == sizeof(Item));
+}
+
+//! sub range, out of range parts are cut off
+template <class Item> Span<Item> Span<Item>::slice(int begin, int end) const
+{
+   if (begin < 0)
+      begin= 0;
+   if (end > mCount)
+      end= mCount;
+   if (begin >= end)
+      return Span(mData, 0, mStride);
+
+   return Span(&(*this)[begin], end - begin, mStride);
+}
+
+template <class Item> int Span<Item>::getChunkCount(int grain) const
+{
+   return ::getChunkCount(mCount, grain);
+}
+
+template <class Item> Span<Item> Span<Item>::getChunk(int chunkCount, int chunk) const
+{
+   return slice(
+      getChunkBegin(mCount, chunkCount, chunk),
+      getChunkBegin(mCount, chunkCount, chunk + 1)
+   );
+}
+
+
+//! copy the first min(dst.size(), src.size()) items, packed items of the same type are copied in one go
+template <class Item, class Source> void copySpan(const Span<Item>& dst, const Span<Source>& src)
+{
+   const int count= (dst.size() < src.size()) ? dst.size() : src.size();
+
+   const bool sameType= std::is_same<typename std::remove_const<Source>::type, Item>::value;
+   if (sameType && dst.isContiguous() && src.isContiguous() && std::is_trivially_copyable<Item>::value)
+   {
+      if (count > 0)
+         memcpy((void*)dst.data(), src.data(), (size_t)count * sizeof(Item));
+   }
+   else
+   {
+      for (int i=0; i<count; i++)
+         dst[i]= src[i];
+   }
+}
+
+
+//! call function(chunk, begin, chunkIndex) for all chunks of "span", chunk views [begin, end)
+template <class Item, class Function> void parallelFor(const Span<Item>& span, Function function, int grain= 4096)
+{
+   parallelFor(span.size(), [&span, &function](int begin, int end, int chunk)
+   {
+      function(span.slice(begin, end), begin, chunk);
+   }, grain);
+}
@@ -0,0 +1,77 @@
+#include "spatialhash.h"
+#include "parallel.h"
+
+
+void SpatialHash::build(const Vector3* points, int count, float cellSize)
+{
+   int i;
+
+   mPoints= points;
+   mInvCellSize= (cellSize > 0.0f) ? 1.0f / cellSize : 1.0f;
+
+   // about one bucket per point
+   int bucketCount= 1;
+   while (bucketCount < count)
+      bucketCount<<= 1;
+   mBucketMask= bucketCount - 1;
+
+   // hash all points in parallel
+   Array<int> buckets(count, true);
+   int* bucket= buckets.data();
+   parallelFor(count, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
+      {
+         const Vector3& p= points[i];
+         bucket[i]= getBucket(getCell(p.x), getCell(p.y), getCell(p.z));
+      }
+   });
+
+   // counting sort by bucket
+   mBucketOffsets.init(bucketCount + 1, true);
+   int* offsets= mBucketOffsets.data();
+   memset(offsets, 0, (bucketCount + 1) * sizeof(int));
+   for (i=0; i<count; i++)
+      offsets[ bucket[i] + 1 ]++;
+   for (i=0; i<bucketCount; i++)
+      offsets[i+1]+= offsets[i];
+
+   mItems.init(count, true);
+   int* items= mItems.data();
+   Array<int> fill(bucketCount, true);
+   memcpy(fill.data(), offsets, bucketCount * sizeof(int));
+   for (i=0; i<count; i++)
+      items[ fill[bucket[i]]++ ]= i;
+}
+
+
+int SpatialHash::findNearest(const Vector3& position, float radius) const
+{
+   int nearest= -1;
+   float nearestDist2= 0.0f;
+
+   forEachNear(position, radius, [&](int index, float dist2)
+   {
+      if (nearest < 0 || dist2 < nearestDist2 || (dist2 == nearestDist2 && index < nearest))
+      {
+         nearest= index;
+         nearestDist2= dist2;
+      }
+   });
+
+   return nearest;
+}
+
+
+int SpatialHash::findFirst(const Vector3& position, float radius) const
+{
+   int first= -1;
+
+   forEachNear(position, radius, [&](int index, float /*dist2*/)
+   {
+      if (first < 0 || index < first)
+         first= index;
+   });
+
+   return first;
+}
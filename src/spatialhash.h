@@ -0,0 +1,98 @@
+/*
+ uniform grid over a set of points for radius queries
+
+ every point is assigned to a grid cell, cells are hashed into a power of two number
+ of buckets. buckets are stored as compressed rows (offsets + point indices),
+ points within a bucket are sorted by index. building is O(n).
+
+ usage:
+ hash.build(points, count, radius);
+ int index= hash.findNearest(position, radius);
+*/
+
+#pragma once
+
+#include "array.h"
+#include "vector3.h"
+#include <math.h>
+
+class SpatialHash
+{
+public:
+   SpatialHash() = default;
+
+   //! bucket the given points, queries should use a radius around cellSize
+   //! the points are referenced, not copied
+   void build(const Vector3* points, int count, float cellSize);
+
+   //! call function(index, distance^2) for every point within radius of position
+   //! a point may be reported twice if two of the visited cells share a bucket
+   template <class Function> void forEachNear(const Vector3& position, float radius, Function function) const;
+
+   //! closest point within radius (-1 if there is none)
+   int findNearest(const Vector3& position, float radius) const;
+
+   //! smallest point index within radius (-1 if there is none)
+   int findFirst(const Vector3& position, float radius) const;
+
+private:
+   int getCell(float value) const;
+   int getBucket(int x, int y, int z) const;
+
+   const Vector3* mPoints = 0;
+   float          mInvCellSize = 1.0f;
+   int            mBucketMask = 0;
+   Array<int>     mBucketOffsets;   //!< bucketCount+1 offsets into mItems
+   Array<int>     mItems;           //!< point indices sorted by bucket
+};
+
+
+inline int SpatialHash::getCell(float value) const
+{
+   // tiny cells put far away points outside the int range, they share the outermost cells
+   const float limit= 1073741824.0f; // 2^30
+   const float cell= floorf(value * mInvCellSize);
+   if (cell >= limit)
+      return (int)limit;
+   if (cell > -limit)
+      return (int)cell;
+   return -(int)limit;
+}
+
+
+inline int SpatialHash::getBucket(int x, int y, int z) const
+{
+   const unsigned int hash= ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+   return (int)(hash & (unsigned int)mBucketMask);
+}
+
+
+template <class Function> void SpatialHash::forEachNear(const Vector3& position, float radius, Function function) const
+{
+   if (mItems.isEmpty())
+      return;
+
+   const float radius2= radius * radius;
+   const int x0= getCell(position.x - radius), x1= getCell(position.x + radius);
+   const int y0= getCell(position.y - radius), y1= getCell(position.y + radius);
+   const int z0= getCell(position.z - radius), z1= getCell(position.z + radius);
+
+   for (int z=z0; z<=z1; z++)
+   {
+      for (int y=y0; y<=y1; y++)
+      {
+         for (int x=x0; x<=x1; x++)
+         {
+            const int bucket= getBucket(x, y, z);
+            const int end= mBucketOffsets[bucket + 1];
+            for (int i=mBucketOffsets[bucket]; i<end; i++)
+            {
+               const int index= mItems[i];
+               const float dist2= (mPoints[index] - position).length2();
+               if (dist2 <= radius2)
+                  function(index, dist2);
+            }
+         }
+      }
+   }
+}
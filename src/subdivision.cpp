@@ -1,7 +1,8 @@
 // implements the loop subdivision sheme on triangles
 
 #include "subdivision.h"
-#include "map.h"
+#include "topology.h"
+#include "parallel.h"
 
 /*
   Subdivision concept:
@@ -26,11 +27,13 @@ numVerts...: new vertices (on edge)
 
 
 
+
+
+
 /*
   Shared edge concept:
-  Defines an edge by two vertex indices (i1,i2)
-  and holds the neighbouring triangles (usually two, one for boundaries)
-  by storing the "missing" vertex indices to build the triangles
+  Each edge (i1,i2) of the topology holds up to two half-edges,
+  the "missing" vertex index of their triangles gives i3 and i4
 
        i3     <- always exist (because edges are extracted from triangles)
        +
@@ -42,226 +45,186 @@ i1 +=======+ i2    edge i1 -> i2
      \   /
       \ /
        +
-       i4     <- absent on boundary edges (-1)
+       i4     <- absent on boundary edges
 */
 
-class SharedEdge
+// block that holds the adjacency of a mesh while it is subdivided. the edge count is
+// not known before the build, edges are at most one per half-edge
+static long long getTopologyArenaSize(int vertexCount, int indexCount)
 {
-public:
-   SharedEdge()
-      : i1(-1), i2(-1), i3(-1), i4(-1)
-   {
-   }
-
-   SharedEdge(int v1, int v2, int v3)
-   {
-      i1= v1;
-      i2= v2;
-      i3= v3;
-      i4= -1;
-   }
-
-   void addTri(int index)
-   {
-      i4=index;
-   }
-
-   int i1,i2;
-   int i3,i4;
-};
-
-struct EdgeMap {
-   int vtxIndex;
-   int edgeIndex;
-};
+   const long long bytes= Topology::estimateBuildPeak(vertexCount, indexCount, indexCount) + 1024;
+   return (bytes + Allocator::sMinAlignment - 1) & ~(long long)(Allocator::sMinAlignment - 1);
+}
 
 
-inline int addEdge(Array<EdgeMap>* edgeMap, Array<SharedEdge>& edgeList, int** vtxNeighbours, int i1, int i2, int i3)
+void loopSubdivision(
+      Array<Vector3>& dstVertices,
+      Array<int>& dstIndices,
+      const Array<Vector3>& srcVertices,
+      const Array<int>& srcIndices,
+      SubdivisionMemory* memory )
 {
-   int edgeIndex;
-
-   // create unique edges so that (i1, i2) has always i1 < i2
-   if (i1 > i2)
-   {
-      int t = i1;
-      i1 = i2;
-      i2 = t;
-   }
+   // the adjacency only lives during this call: place it in one block that fits all of it
+   const int vertexCount= srcVertices.size();
+   const int indexCount= srcIndices.size();
+   Arena arena((size_t)getTopologyArenaSize(vertexCount, indexCount));
 
-   Array<EdgeMap>& map= edgeMap[i1];
-   edgeIndex= -1;
+   Topology topology;
+   topology.build(srcIndices, vertexCount, &arena);
 
-   for (int i=0; i<map.size(); i++)
-   {
-      if (map[i].vtxIndex==i2)
-      {
-         edgeIndex= map[i].edgeIndex;
-         break;
-      }
-   }
-
-   if (edgeIndex < 0)
-   {
-      // new edge
-      SharedEdge edge(i1,i2, i3);
-      edgeIndex= edgeList.add( edge );
-      EdgeMap em;
-      em.vtxIndex= i2;
-      em.edgeIndex= edgeIndex;
-      map.add( em );
-
-      // i1 is connected to i2
-      // i2 is connected to i1
-      int* n1= vtxNeighbours[i1];
-      int* n2= vtxNeighbours[i2];
-      n1[ ++n1[0] ]= i2;
-      n2[ ++n2[0] ]= i1;
-   }
-   else
-   {
-      // edge already exists
-      // -> i1/i2 are already connected
-      // but add shared from this triangle
-      edgeList[edgeIndex].addTri(i3);
-   }
+   loopSubdivision(dstVertices, dstIndices, srcVertices, srcIndices, topology, memory);
 
-   return edgeIndex;
+   // the whole block is held during the call, not only the part the adjacency used
+   if (memory)
+      memory->mTransient= (long long)arena.getCapacity();
 }
 
+
 void loopSubdivision(
       Array<Vector3>& dstVertices,
       Array<int>& dstIndices,
       const Array<Vector3>& srcVertices,
-      const Array<int>& srcIndices )
+      const Array<int>& srcIndices,
+      const Topology& topology,
+      SubdivisionMemory* memory )
 {
-   int i;
-   const int numIndices= srcIndices.size();
-   const int numVerts= srcVertices.size();
+   ArrayStatistics::Scope statistics("subdivision");
+   loopSubdivisionIndices(dstIndices, srcIndices, topology);
 
-   Vector3* srcVtx= srcVertices.data();
-   int* srcIdx= srcIndices.data();
+   dstVertices.init(srcVertices.size() + topology.getEdgeCount(), true);
+   loopSubdivisionVertices(dstVertices, srcVertices, srcIndices, topology);
 
-   Array<int> neighbourCount(numVerts);
-   memset(neighbourCount.data(), 0, numVerts*sizeof(int)); // clear
-   int total= 0;
-
-   for (i=0; i<numIndices; i+=3)
+   if (memory)
    {
-      const int i1= srcIdx[i+0];
-      const int i2= srcIdx[i+1];
-      const int i3= srcIdx[i+2];
-
-      // this happens twice for all neighbouring triangles
-      // so we are about twice
-      neighbourCount[i1]+=2; // i1 -> i2,i3
-      neighbourCount[i2]+=2; // i2 -> i1,i3
-      neighbourCount[i3]+=2; // i3 -> i1,i2
-      total+=6;
+      memory->mInput= srcVertices.getMemoryUsage() + srcIndices.getMemoryUsage();
+      memory->mOutput= dstVertices.getMemoryUsage() + dstIndices.getMemoryUsage();
+      memory->mTransient= 0;
    }
 
-   // allocate enough space to hold a list for each vertex
-   int* buffer= new int[total+numVerts];
-   int** vertexNeighbours= new int*[numVerts];
-   int pos= 0;
-   for (i=0; i<numVerts; i++)
-   {
-      int* list= buffer + pos;
-      list[0]= 0;
-      vertexNeighbours[i]= list;
-      pos += neighbourCount[i]+1;
-   }
+   // qDebug("vertices: %d -> %d", srcVertices.size(), dstVertices.size());
+   // qDebug("triangles:%d -> %d", srcIndices.size()/3, dstIndices.size()/3);
+   // qDebug("edges:    %d", topology.getEdgeCount());
+}
 
-   // find all unique edges, for each triangle: (i1,i2) (i2,i3) (i3,i1)
-   // this process will create e1,e2,e3 so we can build the new index buffer on the fly
-   dstIndices.init(numIndices*4); // each triangle (3 indices) becomes 4 triangles (12 indices)
-   Array<SharedEdge> edges(numIndices); // typically about 1.5 * numTriangles
-   Array<EdgeMap>* edgeMap= new Array<EdgeMap>[numVerts];
-   for (i=0; i<numVerts; i++) edgeMap[i].init(neighbourCount[i]);
 
-   for (i=0; i<numIndices; i+=3)
-   {
-      const int i1= srcIdx[i+0];
-      const int i2= srcIdx[i+1];
-      const int i3= srcIdx[i+2];
-
-      int e1= addEdge(edgeMap, edges, vertexNeighbours, i1,i2,  i3);
-      int e2= addEdge(edgeMap, edges, vertexNeighbours, i2,i3,  i1);
-      int e3= addEdge(edgeMap, edges, vertexNeighbours, i3,i1,  i2);
-
-      e1+=numVerts;
-      e2+=numVerts;
-      e3+=numVerts;
-
-      dstIndices.add(i1); dstIndices.add(e1); dstIndices.add(e3);
-      dstIndices.add(i2); dstIndices.add(e2); dstIndices.add(e1);
-      dstIndices.add(i3); dstIndices.add(e3); dstIndices.add(e2);
-      dstIndices.add(e1); dstIndices.add(e2); dstIndices.add(e3);
-   }
+void loopSubdivisionIndices(
+      Array<int>& dstIndices,
+      const Array<int>& srcIndices,
+      const Topology& topology )
+{
+   const int numIndices= srcIndices.size();
+   const int numVerts= topology.getVertexCount();
+   const int* srcIdx= srcIndices.data();
 
-   // smooth old vertices
-   const int numEdges= edges.size();
-   dstVertices.init(numVerts + numEdges);
-   for (i=0; i<numVerts; i++)
+   // build the new index buffer, edge e becomes vertex numVerts+e
+   dstIndices.init(numIndices*4, true); // each triangle (3 indices) becomes 4 triangles (12 indices)
+   int* dstIdx= dstIndices.data();
+   parallelFor(numIndices / 3, [&](int begin, int end, int /*chunk*/)
    {
-      Vector3 v(0.0f, 0.0f, 0.0f);
-
-      int* list= vertexNeighbours[i];
-      const int n= list[0];
-      for (int j=0; j<n; j++)
+      for (int i=begin*3; i<end*3; i+=3)
       {
-         int nIndex= list[j+1];
-         v+= srcVtx[ nIndex ];
+         const int i1= srcIdx[i+0];
+         const int i2= srcIdx[i+1];
+         const int i3= srcIdx[i+2];
+
+         const int e1= topology.getEdge(i+0) + numVerts;
+         const int e2= topology.getEdge(i+1) + numVerts;
+         const int e3= topology.getEdge(i+2) + numVerts;
+
+         int* dst= dstIdx + i*4;
+         *dst++= i1; *dst++= e1; *dst++= e3;
+         *dst++= i2; *dst++= e2; *dst++= e1;
+         *dst++= i3; *dst++= e3; *dst++= e2;
+         *dst++= e1; *dst++= e2; *dst++= e3;
       }
+   });
+}
 
-      float b;
-      if (n>3)
-         b= 3.0f / (8.0f * n);
-      else
-         b= 3.0f / 16.0f;
-
-      v= v*b + srcVtx[i]*(1.0f-n*b);
 
-      dstVertices.add(v);
-   }
+void loopSubdivisionVertices(
+      Span<Vector3> dstVtx,
+      Span<const Vector3> srcVtx,
+      Span<const int> srcIdx,
+      const Topology& topology )
+{
+   const int numVerts= topology.getVertexCount();
+   const int numEdges= topology.getEdgeCount();
 
-   // create new vertices
-   for (i=0; i<numEdges; i++)
+   // smooth old vertices
+   parallelFor(numVerts, [&](int begin, int end, int /*chunk*/)
    {
-      Vector3 v;
-      const SharedEdge& e= edges[i];
-      const Vector3& v1= srcVtx[e.i1];
-      const Vector3& v2= srcVtx[e.i2];
-      const Vector3& v3= srcVtx[e.i3];
-
-      if (e.i4 == -1)
+      for (int i=begin; i<end; i++)
       {
-         v = (v1 + v2) * 0.4285f + v3 * 0.143f;
+         Vector3 v(0.0f, 0.0f, 0.0f);
+
+         // neighbours are summed up in edge order
+         const int* edges= topology.getVertexEdges(i);
+         const int n= topology.getVertexEdgeCount(i);
+         for (int j=0; j<n; j++)
+         {
+            const int e1= topology.getEdgeVertex(edges[j], 0);
+            const int nIndex= (e1 == i) ? topology.getEdgeVertex(edges[j], 1) : e1;
+            v+= srcVtx[ nIndex ];
+         }
+
+         float b;
+         if (n>3)
+            b= 3.0f / (8.0f * n);
+         else
+            b= 3.0f / 16.0f;
+
+         dstVtx[i]= v*b + srcVtx[i]*(1.0f-n*b);
       }
-      else
+   });
+
+   // create new vertices
+   const Span<Vector3> edgeVtx= dstVtx.slice(numVerts, numVerts + numEdges);
+   parallelFor(numEdges, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int i=begin; i<end; i++)
       {
-         const Vector3& v4= srcVtx[e.i4];
-         v = (v1 + v2) * 0.375f + (v3 + v4) * 0.125f;
+         Vector3 v;
+         const int h1= topology.getEdgeHalfEdge(i, 0);
+         const int h2= topology.getEdgeHalfEdge(i, 1);
+         const Vector3& v1= srcVtx[ topology.getEdgeVertex(i, 0) ];
+         const Vector3& v2= srcVtx[ topology.getEdgeVertex(i, 1) ];
+         const Vector3& v3= srcVtx[ srcIdx[Topology::prev(h1)] ];
+
+         if (h2 < 0)
+         {
+            v = (v1 + v2) * 0.4285f + v3 * 0.143f;
+         }
+         else
+         {
+            const Vector3& v4= srcVtx[ srcIdx[Topology::prev(h2)] ];
+            v = (v1 + v2) * 0.375f + (v3 + v4) * 0.125f;
+         }
+
+         edgeVtx[i]= v;
       }
+   });
+}
 
-      dstVertices.add(v);
-   }
 
-   // average edges per index
-   total= 0;
-   int max= 0;
-   for (i=0; i<numVerts; i++)
+SubdivisionMemory estimateSubdivisionMemory(int vertexCount, int indexCount, int edgeCount, int level)
+{
+   // counts of the input of the last step
+   long long v= vertexCount;
+   long long f= indexCount / 3;
+   long long e= edgeCount;
+   for (int i=1; i<level; i++)
    {
-      const Array<EdgeMap>& map= edgeMap[i];
-      int size= map.size();
-      total += size;
-      if (size > max) max=size;
+      v= v + e;
+      e= 2*e + 3*f;
+      f= 4*f;
    }
 
-   delete[] edgeMap;
-   delete[] buffer;
-
-   // qDebug("vertices: %d -> %d", numVerts, dstVertices.size());
-   // qDebug("triangles:%d -> %d", numIndices/3, dstIndices.size()/3);
-   // qDebug("edges:    %d -> ~%f (%d)", edges.size(), (float)total/numVerts, max);
+   SubdivisionMemory memory;
+   memory.mInput= Array<Vector3>::estimateMemoryUsage((int)v) + Array<int>::estimateMemoryUsage((int)(f * 3));
+   if (level > 0)
+   {
+      memory.mOutput= Array<Vector3>::estimateMemoryUsage((int)(v + e)) + Array<int>::estimateMemoryUsage((int)(f * 12));
+      memory.mTransient= getTopologyArenaSize((int)v, (int)(f * 3));
+   }
+   return memory;
 }
-
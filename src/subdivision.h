@@ -1,14 +1,67 @@
 #pragma once
 
 #include "array.h"
+#include "span.h"
 #include "vector3.h"
 
+class Topology;
+
+// bytes used by one subdivision step
+class SubdivisionMemory
+{
+public:
+   long long mInput = 0;      //!< vertices and indices of the incoming mesh
+   long long mOutput = 0;     //!< vertices and indices of the result
+   long long mTransient = 0;  //!< memory that only lives during the call (adjacency)
+
+   //! everything alive at the end of the step
+   long long getPeak() const { return mInput + mOutput + mTransient; }
+};
+
 // perform loop subdivision sheme on incoming mesh (srcVertices, srcIndices)
 // and fill destination arrays (dstvertices, dstIndices)
+// runs on all threads, the output is the same for any number of threads
+// the memory used by the call is reported if "memory" is given
+void loopSubdivision(
+   Array<Vector3>& dstVertices,
+   Array<int>& dstIndices,
+   const Array<Vector3>& srcVertices,
+   const Array<int>& srcIndices,
+   SubdivisionMemory* memory= 0
+);
+
+// same as above, reusing the adjacency of the incoming mesh (not counted as transient)
 void loopSubdivision(
    Array<Vector3>& dstVertices,
    Array<int>& dstIndices,
    const Array<Vector3>& srcVertices,
-   const Array<int>& srcIndices
+   const Array<int>& srcIndices,
+   const Topology& topology,
+   SubdivisionMemory* memory= 0
 );
 
+// predict the memory of the step that creates "level" from a base mesh with the given
+// vertex, index and edge count (the edge count is Topology::getEdgeCount() of the base).
+// exact for the vertex and index data, the counts follow
+//   faces: f' = 4f    edges: e' = 2e + 3f    vertices: v' = v + e
+// the transient part is the block loopSubdivision() reserves for the adjacency of the input,
+// it is what the call without a topology reports
+SubdivisionMemory estimateSubdivisionMemory(int vertexCount, int indexCount, int edgeCount, int level);
+
+// build the index buffer of a subdivision step, it only depends on the topology
+void loopSubdivisionIndices(
+   Array<int>& dstIndices,
+   const Array<int>& srcIndices,
+   const Topology& topology
+);
+
+// evaluate the vertex positions of a subdivision step into dstVertices
+// (old vertices followed by one vertex per edge: vertexCount + edgeCount)
+// meant for meshes that deform but keep their topology, no arrays are allocated
+// the spans may be slices of larger arrays (e.g. the levels of a LodChain) or strided
+void loopSubdivisionVertices(
+   Span<Vector3> dstVertices,
+   Span<const Vector3> srcVertices,
+   Span<const int> srcIndices,
+   const Topology& topology
+);
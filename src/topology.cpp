@@ -0,0 +1,259 @@
+#include "topology.h"
+#include "parallel.h"
+
+
+// turn counts into compressed row offsets (offsets[i+1]-offsets[i] = count[i])
+static int countsToOffsets(int* offsets, int count)
+{
+   int total= 0;
+   for (int i=0; i<count; i++)
+   {
+      int n= offsets[i];
+      offsets[i]= total;
+      total+= n;
+   }
+   offsets[count]= total;
+   return total;
+}
+
+
+void Topology::build(const Array<int>& indices, int vertexCount, Allocator* allocator)
+{
+   ArrayStatistics::Scope statistics("topology");
+   int h;
+   const int numHalfEdges= indices.size();
+   const int* idx= indices.data();
+
+   // release the previous adjacency before switching allocators, nothing is copied
+   clear();
+   if (!allocator)
+      allocator= Allocator::getHeap();
+   mHalfEdgeEdges.setAllocator(allocator);
+   mEdgeVertices.setAllocator(allocator);
+   mEdgeHalfEdges.setAllocator(allocator);
+   mCornerOffsets.setAllocator(allocator);
+   mCorners.setAllocator(allocator);
+   mVertexEdgeOffsets.setAllocator(allocator);
+   mVertexEdges.setAllocator(allocator);
+
+   mVertexCount= vertexCount;
+
+   // half-edges starting at each vertex (this is also the vertex to triangle map)
+   mCornerOffsets.init(vertexCount + 1, true);
+   int* cornerOffsets= mCornerOffsets.data();
+   memset(cornerOffsets, 0, (vertexCount + 1) * sizeof(int));
+   for (h=0; h<numHalfEdges; h++)
+      cornerOffsets[ idx[h] ]++;
+   countsToOffsets(cornerOffsets, vertexCount);
+
+   mCorners.init(numHalfEdges, true);
+   int* corners= mCorners.data();
+   for (h=0; h<numHalfEdges; h++)
+      corners[ cornerOffsets[idx[h]]++ ]= h;
+   // fill pass moved every offset to the start of its successor
+   for (int v=vertexCount; v>0; v--)
+      cornerOffsets[v]= cornerOffsets[v-1];
+   cornerOffsets[0]= 0;
+
+   // number the undirected edges
+   // all half-edges (a,b) and (b,a) share one edge, they are found in the corner lists of a and b.
+   // the half-edge with the smallest index owns the edge and edges are numbered by their owners,
+   // so the numbering is the same as in a serial walk over the triangles, whatever the thread count
+   mHalfEdgeEdges.init(numHalfEdges, true);
+   int* halfEdgeEdges= mHalfEdgeEdges.data();
+   Array<int> lastHalfEdges(allocator, numHalfEdges, true);
+   int* lastHalfEdge= lastHalfEdges.data();
+
+   const int chunkCount= getChunkCount(numHalfEdges);
+   Array<int> chunkEdges(allocator, chunkCount + 1, true);
+   int* chunkEdge= chunkEdges.data();
+
+   // 1st pass: find first and last half-edge of each edge, count owners per chunk
+   parallelFor(numHalfEdges, [&](int begin, int end, int chunk)
+   {
+      int owners= 0;
+      for (int h=begin; h<end; h++)
+      {
+         const int a= idx[h];
+         const int b= idx[ next(h) ];
+         int first= h;
+         int last= -1;
+
+         const int* list= getCorners(a);
+         int count= getCornerCount(a);
+         for (int i=0; i<count; i++)
+         {
+            const int other= list[i];
+            if (other != h && idx[ next(other) ] == b)
+            {
+               if (other < first) first= other;
+               if (other > last) last= other;
+            }
+         }
+
+         list= getCorners(b);
+         count= getCornerCount(b);
+         for (int i=0; i<count; i++)
+         {
+            const int other= list[i];
+            if (other != h && idx[ next(other) ] == a)
+            {
+               if (other < first) first= other;
+               if (other > last) last= other;
+            }
+         }
+
+         // owner: -1, others reference their owner
+         if (first == h)
+         {
+            halfEdgeEdges[h]= -1;
+            lastHalfEdge[h]= last;
+            owners++;
+         }
+         else
+         {
+            halfEdgeEdges[h]= first;
+         }
+      }
+      chunkEdge[chunk]= owners;
+   });
+
+   // prefix sum over the owner counts gives the first edge of each chunk
+   countsToOffsets(chunkEdge, chunkCount);
+   const int numEdges= chunkEdge[chunkCount];
+
+   // 2nd pass: number the edges in owner order and fill in their vertices and half-edges
+   // non-manifold edges keep their first and their last half-edge
+   mEdgeVertices.init(numEdges * 2, true);
+   mEdgeHalfEdges.init(numEdges * 2, true);
+   int* edgeVertices= mEdgeVertices.data();
+   int* edgeHalfEdges= mEdgeHalfEdges.data();
+   parallelFor(numHalfEdges, [&](int begin, int end, int chunk)
+   {
+      int edge= chunkEdge[chunk];
+      for (int h=begin; h<end; h++)
+      {
+         if (halfEdgeEdges[h] < 0)
+         {
+            const int a= idx[h];
+            const int b= idx[ next(h) ];
+            edgeVertices[edge*2]=   (a < b) ? a : b;
+            edgeVertices[edge*2+1]= (a < b) ? b : a;
+            edgeHalfEdges[edge*2]= h;
+            edgeHalfEdges[edge*2+1]= lastHalfEdge[h];
+            lastHalfEdge[h]= edge; // owners keep their edge here until all edges are numbered
+            edge++;
+         }
+      }
+   });
+
+   // 3rd pass: resolve references to the owners
+   parallelFor(numHalfEdges, [&](int begin, int end, int /*chunk*/)
+   {
+      for (int h=begin; h<end; h++)
+      {
+         const int owner= halfEdgeEdges[h];
+         halfEdgeEdges[h]= lastHalfEdge[ (owner < 0) ? h : owner ];
+      }
+   });
+
+   // edges adjacent to each vertex, filled in edge order
+   mVertexEdgeOffsets.init(vertexCount + 1, true);
+   int* vertexEdgeOffsets= mVertexEdgeOffsets.data();
+   memset(vertexEdgeOffsets, 0, (vertexCount + 1) * sizeof(int));
+   for (int e=0; e<numEdges*2; e++)
+      vertexEdgeOffsets[ edgeVertices[e] ]++;
+   countsToOffsets(vertexEdgeOffsets, vertexCount);
+
+   mVertexEdges.init(numEdges * 2, true);
+   int* vertexEdges= mVertexEdges.data();
+   for (int e=0; e<numEdges*2; e++)
+      vertexEdges[ vertexEdgeOffsets[edgeVertices[e]]++ ]= e >> 1;
+   for (int v=vertexCount; v>0; v--)
+      vertexEdgeOffsets[v]= vertexEdgeOffsets[v-1];
+   vertexEdgeOffsets[0]= 0;
+
+   mBuildPeak= getMemoryUsage() + lastHalfEdges.getMemoryUsage() + chunkEdges.getMemoryUsage();
+}
+
+
+void Topology::clear()
+{
+   mVertexCount= 0;
+   mBuildPeak= 0;
+   mHalfEdgeEdges.init(0);
+   mEdgeVertices.init(0);
+   mEdgeHalfEdges.init(0);
+   mCornerOffsets.init(0);
+   mCorners.init(0);
+   mVertexEdgeOffsets.init(0);
+   mVertexEdges.init(0);
+}
+
+
+int Topology::getVertexCount() const
+{
+   return mVertexCount;
+}
+
+
+int Topology::getHalfEdgeCount() const
+{
+   return mHalfEdgeEdges.size();
+}
+
+
+int Topology::getEdgeCount() const
+{
+   return mEdgeVertices.size() / 2;
+}
+
+
+bool Topology::isBoundaryVertex(int v) const
+{
+   const int* edges= getVertexEdges(v);
+   const int count= getVertexEdgeCount(v);
+   for (int i=0; i<count; i++)
+   {
+      if (isBoundaryEdge(edges[i]))
+         return true;
+   }
+   return false;
+}
+
+
+long long Topology::getMemoryUsage() const
+{
+   return
+        mHalfEdgeEdges.getMemoryUsage()
+      + mEdgeVertices.getMemoryUsage()
+      + mEdgeHalfEdges.getMemoryUsage()
+      + mCornerOffsets.getMemoryUsage()
+      + mCorners.getMemoryUsage()
+      + mVertexEdgeOffsets.getMemoryUsage()
+      + mVertexEdges.getMemoryUsage();
+}
+
+
+long long Topology::getBuildPeak() const
+{
+   return mBuildPeak;
+}
+
+
+long long Topology::estimateMemoryUsage(int vertexCount, int halfEdgeCount, int edgeCount)
+{
+   // two offset tables, two per half-edge tables, three tables with two entries per edge
+   return
+        2 * Array<int>::estimateMemoryUsage(vertexCount + 1)
+      + 2 * Array<int>::estimateMemoryUsage(halfEdgeCount)
+      + 3 * Array<int>::estimateMemoryUsage(edgeCount * 2);
+}
+
+
+long long Topology::estimateBuildPeak(int vertexCount, int halfEdgeCount, int edgeCount)
+{
+   // one more per half-edge table while numbering the edges, chunk counts are negligible
+   return estimateMemoryUsage(vertexCount, halfEdgeCount, edgeCount)
+      + Array<int>::estimateMemoryUsage(halfEdgeCount);
+}
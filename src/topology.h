@@ -0,0 +1,137 @@
+/*
+ half-edge adjacency of a triangle mesh, stored in flat arrays
+
+ half-edges share their numbering with the index buffer:
+ half-edge h runs from corner h to the next corner of triangle h/3
+
+          i3
+          +
+         / \
+   h+2  /   \  h+1      h   = 3 * triangle
+       /     \          h+1 = 3 * triangle + 1
+   i1 +-------+ i2      h+2 = 3 * triangle + 2
+          h
+
+ undirected edges are numbered in the order they are first seen when walking
+ the triangles' edges (i1,i2) (i2,i3) (i3,i1). this is the order in which
+ loopSubdivision() creates its edge vertices.
+
+ per-vertex lists are stored as compressed rows: the entries of vertex v are
+ list[offsets[v]] .. list[offsets[v+1]-1]
+ no per-vertex arrays are allocated, the whole structure is built in O(n)
+*/
+
+#pragma once
+
+#include "array.h"
+
+class Topology
+{
+public:
+   Topology() = default;
+
+   //! build adjacency of the given triangles
+   //! all arrays, including temporary ones, come from "allocator" (default: heap) which
+   //! has to outlive the adjacency
+   void build(const Array<int>& indices, int vertexCount, Allocator* allocator= 0);
+
+   //! release all adjacency data
+   void clear();
+
+   int getVertexCount() const;
+   int getHalfEdgeCount() const;
+   int getEdgeCount() const;
+
+   //! next half-edge within the same triangle
+   static inline int next(int h)
+   {
+      return (h % 3 == 2) ? h - 2 : h + 1;
+   }
+
+   //! previous half-edge within the same triangle
+   static inline int prev(int h)
+   {
+      return (h % 3 == 0) ? h + 2 : h - 1;
+   }
+
+   //! undirected edge of half-edge h
+   inline int getEdge(int h) const
+   {
+      return mHalfEdgeEdges[h];
+   }
+
+   //! opposite half-edge of h (-1 on boundaries)
+   //! non-manifold edges pair their first and last half-edge, the ones in between get -1
+   inline int getTwin(int h) const
+   {
+      const int* halfEdges= mEdgeHalfEdges.data() + 2 * mHalfEdgeEdges[h];
+      if (halfEdges[0] == h)
+         return halfEdges[1];
+      if (halfEdges[1] == h)
+         return halfEdges[0];
+      return -1;
+   }
+
+   //! edge vertex (index 0 or 1), vertex 0 is always the smaller index
+   inline int getEdgeVertex(int e, int index) const
+   {
+      return mEdgeVertices[2 * e + index];
+   }
+
+   //! half-edges of an edge (index 0 or 1), the 2nd is -1 on boundaries
+   inline int getEdgeHalfEdge(int e, int index) const
+   {
+      return mEdgeHalfEdges[2 * e + index];
+   }
+
+   inline bool isBoundaryEdge(int e) const
+   {
+      return mEdgeHalfEdges[2 * e + 1] < 0;
+   }
+
+   //! half-edges starting at vertex v (ascending)
+   inline int getCornerCount(int v) const
+   {
+      return mCornerOffsets[v + 1] - mCornerOffsets[v];
+   }
+
+   inline const int* getCorners(int v) const
+   {
+      return mCorners.data() + mCornerOffsets[v];
+   }
+
+   //! edges adjacent to vertex v (ascending)
+   inline int getVertexEdgeCount(int v) const
+   {
+      return mVertexEdgeOffsets[v + 1] - mVertexEdgeOffsets[v];
+   }
+
+   inline const int* getVertexEdges(int v) const
+   {
+      return mVertexEdges.data() + mVertexEdgeOffsets[v];
+   }
+
+   //! vertex has at least one boundary edge
+   bool isBoundaryVertex(int v) const;
+
+   //! bytes held by the adjacency
+   long long getMemoryUsage() const;
+
+   //! bytes in use at the end of the last build(): adjacency plus temporary buffers
+   long long getBuildPeak() const;
+
+   //! memory of the adjacency and build peak for the given counts, before building it
+   static long long estimateMemoryUsage(int vertexCount, int halfEdgeCount, int edgeCount);
+   static long long estimateBuildPeak(int vertexCount, int halfEdgeCount, int edgeCount);
+
+private:
+   int        mVertexCount = 0;
+   long long  mBuildPeak = 0;
+   Array<int> mHalfEdgeEdges;       //!< undirected edge of each half-edge
+   Array<int> mEdgeVertices;        //!< 2 vertex indices per edge (ascending)
+   Array<int> mEdgeHalfEdges;       //!< 2 half-edges per edge (2nd is -1 on boundaries)
+   Array<int> mCornerOffsets;       //!< vertexCount+1 offsets into mCorners
+   Array<int> mCorners;             //!< half-edges starting at each vertex
+   Array<int> mVertexEdgeOffsets;   //!< vertexCount+1 offsets into mVertexEdges
+   Array<int> mVertexEdges;         //!< edges adjacent to each vertex
+};
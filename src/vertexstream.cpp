@@ -0,0 +1,171 @@
+#include "vertexstream.h"
+#include "mesh.h"
+#include "parallel.h"
+#include <string.h>
+
+
+VertexLayout::VertexLayout(NormalFormat normals, TexcoordFormat texcoords)
+ : mNormalFormat(normals)
+ , mTexcoordFormat(texcoords)
+ , mNormalOffset(-1)
+ , mTexcoordOffset(-1)
+{
+   int offset= sizeof(Vector3);
+
+   if (normals != NormalNone)
+   {
+      mNormalOffset= offset;
+      offset+= (normals == NormalFloat) ? 3 * sizeof(float) : 4 * sizeof(unsigned short);
+   }
+
+   if (texcoords != TexcoordNone)
+   {
+      mTexcoordOffset= offset;
+      offset+= (texcoords == TexcoordFloat) ? 2 * sizeof(float) : 2 * sizeof(unsigned short);
+   }
+
+   mStride= offset;
+}
+
+
+VertexLayout::NormalFormat VertexLayout::getNormalFormat() const
+{
+   return mNormalFormat;
+}
+
+
+VertexLayout::TexcoordFormat VertexLayout::getTexcoordFormat() const
+{
+   return mTexcoordFormat;
+}
+
+
+int VertexLayout::getNormalOffset() const
+{
+   return mNormalOffset;
+}
+
+
+int VertexLayout::getTexcoordOffset() const
+{
+   return mTexcoordOffset;
+}
+
+
+int VertexLayout::getStride() const
+{
+   return mStride;
+}
+
+
+unsigned short floatToHalf(float value)
+{
+   unsigned int bits;
+   memcpy(&bits, &value, sizeof(float));
+
+   const unsigned int sign= (bits >> 16) & 0x8000;
+   const int exponent= (int)((bits >> 23) & 0xff) - 127 + 15;
+   unsigned int mantissa= bits & 0x7fffff;
+
+   // infinity and nan (keep nan quiet)
+   if ((bits & 0x7fffffff) >= 0x7f800000)
+      return (unsigned short)(sign | (mantissa ? 0x7e00 : 0x7c00));
+
+   // subnormal or zero
+   if (exponent <= 0)
+   {
+      if (exponent < -10)
+         return (unsigned short)sign;
+
+      mantissa|= 0x800000;
+      const int shift= 14 - exponent;
+      unsigned int half= mantissa >> shift;
+      const unsigned int rest= mantissa & ((1u << shift) - 1);
+      const unsigned int halfway= 1u << (shift - 1);
+      if (rest > halfway || (rest == halfway && (half & 1)))
+         half++;
+      return (unsigned short)(sign | half);
+   }
+
+   // rounding may carry into the exponent, too large values become infinity
+   unsigned int half= ((unsigned int)exponent << 10) | (mantissa >> 13);
+   const unsigned int rest= mantissa & 0x1fff;
+   if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+      half++;
+   if (exponent >= 31 || half > 0x7c00)
+      half= 0x7c00;
+   return (unsigned short)(sign | half);
+}
+
+
+static inline unsigned short toUnorm16(float value)
+{
+   if (value <= 0.0f)
+      return 0;
+   if (value >= 1.0f)
+      return 65535;
+   return (unsigned short)(value * 65535.0f + 0.5f);
+}
+
+
+void writeVertexStream(
+      void* dst,
+      const VertexLayout& layout,
+      Span<const Vector3> positions,
+      Span<const Vector3> normals,
+      Span<const Vector2> texcoords )
+{
+   const int vertexCount= positions.size();
+   const bool hasNormals= (normals.size() >= vertexCount);
+   const bool hasTexcoords= (texcoords.size() >= vertexCount);
+   const int stride= layout.getStride();
+   const int normalOffset= layout.getNormalOffset();
+   const int texcoordOffset= layout.getTexcoordOffset();
+   const VertexLayout::NormalFormat normalFormat= layout.getNormalFormat();
+   const VertexLayout::TexcoordFormat texcoordFormat= layout.getTexcoordFormat();
+   const Vector3 zero3(0.0f, 0.0f, 0.0f);
+   const Vector2 zero2(0.0f, 0.0f);
+
+   parallelFor(positions, [&](Span<const Vector3> range, int begin, int /*chunk*/)
+   {
+      unsigned char* vertex= (unsigned char*)dst + (size_t)begin * stride;
+      for (int i=begin; i<begin+range.size(); i++, vertex+= stride)
+      {
+         memcpy(vertex, &positions[i], sizeof(Vector3));
+
+         if (normalOffset >= 0)
+         {
+            const Vector3& n= hasNormals ? normals[i] : zero3;
+            if (normalFormat == VertexLayout::NormalFloat)
+            {
+               memcpy(vertex + normalOffset, &n, sizeof(Vector3));
+            }
+            else
+            {
+               const unsigned short half[4]= { floatToHalf(n.x), floatToHalf(n.y), floatToHalf(n.z), 0 };
+               memcpy(vertex + normalOffset, half, sizeof(half));
+            }
+         }
+
+         if (texcoordOffset >= 0)
+         {
+            const Vector2& uv= hasTexcoords ? texcoords[i] : zero2;
+            if (texcoordFormat == VertexLayout::TexcoordFloat)
+            {
+               memcpy(vertex + texcoordOffset, &uv, sizeof(Vector2));
+            }
+            else
+            {
+               const unsigned short unorm[2]= { toUnorm16(uv.x), toUnorm16(uv.y) };
+               memcpy(vertex + texcoordOffset, unorm, sizeof(unorm));
+            }
+         }
+      }
+   });
+}
+
+
+void writeVertexStream(void* dst, const VertexLayout& layout, const Mesh* mesh)
+{
+   writeVertexStream(dst, layout, mesh->getVertices(), mesh->getNormals(), mesh->getTexcoords());
+}
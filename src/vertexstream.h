@@ -0,0 +1,75 @@
+/*
+ interleaved vertex export for vertex buffers
+
+ a VertexLayout describes one packed vertex:
+   position   3 floats (always)
+   normal     3 floats, or 4 half floats (x,y,z,0)
+   texcoord   2 floats, or 2 unsigned shorts (0..1 mapped to 0..65535, values are clamped)
+
+ writeVertexStream() fills the buffer in parallel chunks, every vertex is written
+ once and front to back, nothing is read back. this suits write-combined memory
+ such as the pointer returned by lockVertexBuffer().
+*/
+
+#pragma once
+
+#include "span.h"
+#include "vector2.h"
+#include "vector3.h"
+
+class Mesh;
+
+class VertexLayout
+{
+public:
+   enum NormalFormat
+   {
+      NormalNone,
+      NormalFloat,     //!< 12 bytes
+      NormalHalf       //!< 8 bytes
+   };
+
+   enum TexcoordFormat
+   {
+      TexcoordNone,
+      TexcoordFloat,   //!< 8 bytes
+      TexcoordUnorm16  //!< 4 bytes
+   };
+
+   VertexLayout(NormalFormat normals= NormalFloat, TexcoordFormat texcoords= TexcoordFloat);
+
+   NormalFormat   getNormalFormat() const;
+   TexcoordFormat getTexcoordFormat() const;
+
+   //! byte offsets within a vertex (-1: attribute not stored)
+   int getNormalOffset() const;
+   int getTexcoordOffset() const;
+
+   //! bytes per vertex
+   int getStride() const;
+
+private:
+   NormalFormat   mNormalFormat;
+   TexcoordFormat mTexcoordFormat;
+   int            mNormalOffset;
+   int            mTexcoordOffset;
+   int            mStride;
+};
+
+
+//! pack positions.size() vertices into dst (positions.size() * layout.getStride() bytes)
+//! attributes the layout does not store are ignored, source spans with fewer items
+//! than positions (e.g. empty ones) are written as zero. sources may be strided.
+void writeVertexStream(
+   void* dst,
+   const VertexLayout& layout,
+   Span<const Vector3> positions,
+   Span<const Vector3> normals,
+   Span<const Vector2> texcoords
+);
+
+//! same as above for all vertices of a mesh
+void writeVertexStream(void* dst, const VertexLayout& layout, const Mesh* mesh);
+
+//! ieee 754 half precision, rounded to nearest
+unsigned short floatToHalf(float value);
@@ -11,6 +11,13 @@ OBJECTS_DIR=.obj
 MOC_DIR=.moc
 
 CONFIG += opengl
+CONFIG += c++11 thread
+
+# count Array allocations per tag, printed at exit (see src/arraystatistics.h)
+# DEFINES += ARRAY_STATISTICS
+
+# Array regression checks and the storage benchmark are separate console targets:
+# tests/arraytest.pro, tests/arraybench.pro
 
 win32: LIBS += -lopengl32
 win32: DEFINES += _USE_MATH_DEFINES
@@ -29,6 +36,17 @@ HEADERS += \
     src/shader.h \
     src/mesh.h \
     src/subdivision.h \
+    src/topology.h \
+    src/parallel.h \
+    src/skinning.h \
+    src/multires.h \
+    src/lazysubdivision.h \
+    src/spatialhash.h \
+    src/bvh.h \
+    src/lodchain.h \
+    src/meshfile.h \
+    src/vertexstream.h \
+    src/simplification.h \
     src/objloader.h
 
 SOURCES += \
@@ -37,6 +55,17 @@ SOURCES += \
     src/gldevice.cpp \
     src/mesh.cpp \
     src/subdivision.cpp \
+    src/topology.cpp \
+    src/parallel.cpp \
+    src/skinning.cpp \
+    src/multires.cpp \
+    src/lazysubdivision.cpp \
+    src/spatialhash.cpp \
+    src/bvh.cpp \
+    src/lodchain.cpp \
+    src/meshfile.cpp \
+    src/vertexstream.cpp \
+    src/simplification.cpp \
     src/objloader.cpp
 
 HEADERS += \
@@ -45,8 +74,14 @@ HEADERS += \
 
 HEADERS += \
     src/array.h \
+    src/smallarray.h \
+    src/span.h \
     src/referenced.h \
+    src/allocator.h \
+    src/arraystatistics.h \
     src/singleton.h \
 
 SOURCES += \
     src/referenced.cpp \
+    src/allocator.cpp \
+    src/arraystatistics.cpp \
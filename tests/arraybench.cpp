@@ -0,0 +1,233 @@
+/*
+ microbenchmark of the Array storage against the new[]/delete[] storage it replaced
+
+ NewArray below is the old storage path of Array for unshared data: new[] for every
+ allocation, item by item copies on resize, growth and append, and the same reference
+ count check in front of every add(). both are timed on the same operations, the best
+ of several runs is printed in milliseconds.
+
+ build and run (optimized):
+ qmake arraybench.pro && make && ./arraybench
+*/
+
+#include "array.h"
+#include "vector3.h"
+#include <chrono>
+#include <stdio.h>
+
+// old storage: new[] and item by item copies, doubling from 16 items
+// (the data is never shared here, so copyRef() only costs its call like it used to)
+template <class Item>
+class NewArray : public Referenced
+{
+public:
+   NewArray() : mData(0), mSize(0), mCount(0) {}
+   ~NewArray() { delete[] mData; }
+
+   NewArray(const NewArray&) = delete;
+   NewArray& operator = (const NewArray&) = delete;
+
+   void init(int size, bool fill= false)
+   {
+      delete[] mData;
+      mData= (size > 0) ? new Item[size] : 0;
+      mSize= size;
+      mCount= fill ? size : 0;
+   }
+
+   void resize(int size)
+   {
+      Item* temp= mData;
+      mData= new Item[size];
+      mSize= size;
+      if (mCount > mSize)
+         mCount= mSize;
+      for (int i=0; i<mCount; i++)
+         mData[i]= temp[i];
+      delete[] temp;
+   }
+
+   int add(const Item& item)
+   {
+      copyRef();
+      if (mCount >= mSize)
+         grow();
+      mData[mCount]= item;
+      return mCount++;
+   }
+
+   void add(const NewArray& data)
+   {
+      copyRef();
+      if (mCount + data.size() >= mSize)
+      {
+         Item* temp= mData;
+         mSize= mCount + data.size();
+         mData= new Item[mSize];
+         for (int i=0; i<mCount; i++)
+            mData[i]= temp[i];
+         delete[] temp;
+      }
+      for (int i=0; i<data.size(); i++)
+         mData[mCount+i]= data[i];
+      mCount+= data.size();
+   }
+
+   Item& operator[](int index) const { return mData[index]; }
+   int size() const { return mCount; }
+
+private:
+   void grow()
+   {
+      Item* temp= mData;
+      mSize= mSize ? (mSize << 1) : 16;
+      mData= new Item[mSize];
+      for (int i=0; i<mCount; i++)
+         mData[i]= temp[i];
+      delete[] temp;
+   }
+
+   Item* mData;
+   int   mSize;
+   int   mCount;
+};
+
+
+// keeps the compiler from dropping the work
+static volatile float sink;
+
+static float getValue(int value) { return (float)value; }
+static float getValue(const Vector3& value) { return value.x; }
+
+static Vector3 makeItem(Vector3*, int i) { return Vector3((float)i, 0.0f, 0.0f); }
+static int makeItem(int*, int i) { return i; }
+
+
+// best time of "runs" calls of function() in milliseconds
+template <class Function> static double measure(Function function, int runs= 7)
+{
+   double best= 1e30;
+   for (int run=0; run<runs; run++)
+   {
+      const auto start= std::chrono::steady_clock::now();
+      function();
+      const auto end= std::chrono::steady_clock::now();
+      const double ms= std::chrono::duration<double, std::milli>(end - start).count();
+      if (ms < best)
+         best= ms;
+   }
+   return best;
+}
+
+
+static void report(const char* operation, const char* type, int count, int repeat, double oldMs, double newMs)
+{
+   printf("%-14s %-8s %8d x %-5d  new[] %9.3f ms   Array %9.3f ms   %5.2fx\n",
+      operation, type, count, repeat, oldMs, newMs, oldMs / newMs);
+}
+
+
+// "count" items, all operations "repeat" times
+template <class Item> static void benchmark(const char* type, int count, int repeat)
+{
+   Item* tag= 0;
+
+   // init(n, fill): allocation, plus construction for new[]
+   report("init", type, count, repeat,
+      measure([&]() { for (int r=0; r<repeat; r++) { NewArray<Item> a; a.init(count, true); sink= getValue(a[count-1]); } }),
+      measure([&]() { for (int r=0; r<repeat; r++) { Array<Item> a; a.init(count, true); sink= getValue(a[count-1]); } })
+   );
+
+   // resize to twice the size, keeping all items
+   report("resize", type, count, repeat,
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            NewArray<Item> a;
+            a.init(count, true);
+            for (int i=0; i<count; i++)
+               a[i]= makeItem(tag, i);
+            a.resize(count * 2);
+            sink= getValue(a[count-1]);
+         }
+      }),
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            Array<Item> a;
+            a.init(count, true);
+            for (int i=0; i<count; i++)
+               a[i]= makeItem(tag, i);
+            a.resize(count * 2);
+            sink= getValue(a[count-1]);
+         }
+      })
+   );
+
+   // add(const Array&) appending a list of the same length
+   NewArray<Item> oldSource;
+   Array<Item> newSource;
+   for (int i=0; i<count; i++)
+   {
+      oldSource.add(makeItem(tag, i));
+      newSource.add(makeItem(tag, i));
+   }
+   report("add(Array)", type, count, repeat,
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            NewArray<Item> a;
+            a.add(oldSource);
+            a.add(oldSource);
+            sink= getValue(a[2*count-1]);
+         }
+      }),
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            Array<Item> a;
+            a.add(newSource);
+            a.add(newSource);
+            sink= getValue(a[2*count-1]);
+         }
+      })
+   );
+
+   // growth: add() one item at a time from an empty array
+   report("add(Item)", type, count, repeat,
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            NewArray<Item> a;
+            for (int i=0; i<count; i++)
+               a.add(makeItem(tag, i));
+            sink= getValue(a[count-1]);
+         }
+      }),
+      measure([&]()
+      {
+         for (int r=0; r<repeat; r++)
+         {
+            Array<Item> a;
+            for (int i=0; i<count; i++)
+               a.add(makeItem(tag, i));
+            sink= getValue(a[count-1]);
+         }
+      })
+   );
+}
+
+
+int main()
+{
+   benchmark<int>("int", 1000, 1000);
+   benchmark<Vector3>("Vector3", 1000, 1000);
+   benchmark<int>("int", 1000000, 10);
+   benchmark<Vector3>("Vector3", 1000000, 10);
+   return 0;
+}
@@ -0,0 +1,18 @@
+# Array storage against the old new[] storage, see arraybench.cpp
+# qmake arraybench.pro && make && ./arraybench
+
+TEMPLATE = app
+TARGET = arraybench
+DEPENDPATH += . ../src
+INCLUDEPATH += . ../src
+
+OBJECTS_DIR=.obj-arraybench
+
+CONFIG += console c++11 thread release
+CONFIG -= qt app_bundle debug
+
+SOURCES += \
+    arraybench.cpp \
+    ../src/allocator.cpp \
+    ../src/referenced.cpp \
+    ../src/arraystatistics.cpp
@@ -0,0 +1,303 @@
+/*
+ regression checks for Array and SmallArray
+
+ covers the storage paths reworked for trivially copyable items, reference counting,
+ allocators, alignment and raw data. every failed check is printed, the exit code is
+ the number of failures.
+
+ build and run:
+ qmake arraytest.pro && make && ./arraytest
+*/
+
+#include "array.h"
+#include "smallarray.h"
+#include "vector3.h"
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+static int failures= 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool condition, const char* text, int line)
+{
+   if (!condition)
+   {
+      printf("line %d: %s\n", line, text);
+      failures++;
+   }
+}
+
+
+static bool isAligned(const void* data, size_t alignment)
+{
+   return ((size_t)data & (alignment - 1)) == 0;
+}
+
+
+// copies of an array share its data until one of them is written through a modifying call
+static void testCopyOnWrite()
+{
+   Array<int> a;
+   for (int i=0; i<100; i++)
+      a.add(i);
+
+   Array<int> b= a;
+   CHECK(b.data() == a.data() && a.getRefCount() == 2);
+
+   b.add(100);
+   CHECK(b.data() != a.data() && a.getRefCount() == 1 && b.getRefCount() == 1);
+   CHECK(a.size() == 100 && b.size() == 101 && b[99] == 99);
+
+   // appending a list to shared data must not write behind the copy
+   Array<int> c= a;
+   c.add(a);
+   CHECK(c.size() == 200 && c[150] == 50 && a.size() == 100);
+
+   Array<int> d= a;
+   d.resize(10);
+   CHECK(d.size() == 10 && a.size() == 100 && a[50] == 50);
+
+   Array<int> e= a;
+   e.insert(0, -1);
+   CHECK(e[0] == -1 && e[1] == 0 && a[0] == 0);
+
+   Array<int> f= a;
+   f.removeAt(0);
+   CHECK(f[0] == 1 && a[0] == 0);
+
+   Array<int> g= a;
+   g.clear();
+   CHECK(g.size() == 0 && a.size() == 100);
+
+   // assignment drops the previous reference
+   Array<int> h= a;
+   h= b;
+   CHECK(a.getRefCount() == 1 && b.getRefCount() == 2);
+}
+
+
+// items passed in may live in the array that is about to move its storage
+static void testSelfReference()
+{
+   Array<int> a;
+   a.add(1);
+   a.add(2);
+   for (int i=0; i<6; i++)
+      a.add(a);
+   CHECK(a.size() == 128 && a[126] == 1 && a[127] == 2);
+
+   Array<Vector3> v;
+   v.add(Vector3(1.0f, 2.0f, 3.0f));
+   while (v.size() < v.capacity())
+      v.add(v[0]);
+   v.add(v[0]);
+   CHECK(v.getLast() == Vector3(1.0f, 2.0f, 3.0f));
+
+   Array<int> b;
+   for (int i=0; i<16; i++)
+      b.add(i);
+   b.insert(0, b[15]);
+   CHECK(b.size() == 17 && b[0] == 15 && b[16] == 15);
+
+   // insert into an empty array
+   Array<int> c;
+   c.insert(0, 7);
+   CHECK(c.size() == 1 && c[0] == 7 && c.capacity() > 0);
+
+   // copy of itself and of another reference to the same data
+   Array<int> d= b;
+   d.copy(d);
+   CHECK(d.size() == 17 && d[1] == 0);
+   d.copy(b);
+   CHECK(d.size() == 17 && d.data() != b.data());
+}
+
+
+static void testRawData()
+{
+   int buffer[4]= {1, 2, 3, 4};
+
+   Array<int> a;
+   a.setRawData(buffer, 4);
+   CHECK(a.isRawData() && a.data() == buffer && a.getMemoryUsage() == 0);
+
+   // writes go to the buffer, copies share it
+   a[0]= 7;
+   CHECK(buffer[0] == 7);
+   Array<int> b= a;
+   CHECK(b.isRawData() && b.data() == buffer);
+
+   // growing moves to owned memory and leaves the buffer alone
+   a.add(5);
+   CHECK(!a.isRawData() && a.size() == 5 && a[0] == 7 && a[4] == 5 && buffer[3] == 4);
+   CHECK(b.data() == buffer && b.getRefCount() == 1);
+
+   Array<int> c;
+   c.setRawData(buffer, 4);
+   c.init(3);
+   CHECK(!c.isRawData() && c.data() != buffer);
+}
+
+
+static void testArena()
+{
+   Arena arena(1024);
+   {
+      Array<int> a(&arena);
+      for (int i=0; i<1000; i++)
+         a.add(i);
+      CHECK(a.size() == 1000 && a[999] == 999 && a.getAllocator() == &arena);
+
+      // references share the allocator of their data, copies on write stay in it
+      Array<int> b= a;
+      b.add(1000);
+      CHECK(b.getAllocator() == &arena && a[999] == 999 && b[1000] == 1000);
+
+      Array<Vector3> v(&arena, 300, true);
+      CHECK(isAligned(v.data(), Allocator::sCacheLineSize));
+
+      // moving to the heap copies the items over
+      a.setAllocator(Allocator::getHeap());
+      CHECK(a.size() == 1000 && a[500] == 500);
+   }
+   CHECK(arena.getUsed() > 0);
+   arena.reset();
+   CHECK(arena.getUsed() == 0 && arena.getCapacity() > 0);
+}
+
+
+// std::string is constructed, copied and destroyed item by item
+template <class References> static void testNonTrivial(Allocator* allocator)
+{
+   Array<std::string, References> a(allocator);
+   for (int i=0; i<300; i++)
+      a.add(std::to_string(i));
+
+   Array<std::string, References> b= a;
+   b.insert(0, b[299]);
+   b.removeAt(1);
+   CHECK(b[0] == "299" && b[1] == "1" && b.size() == 300 && a[0] == "0");
+
+   b.resize(1000);
+   CHECK(b.size() == 300 && b[299] == "299");
+   b.resize(2);
+   CHECK(b.size() == 2 && b[1] == "1");
+
+   CHECK(a.remove("7") == 1 && a.size() == 299 && !a.contains("7"));
+
+   Array<std::string, References> c;
+   c.copy(a);
+   c.add(c[0]);
+   CHECK(c.size() == 300 && c.getLast() == "0");
+}
+
+
+static void testAtomicReferences()
+{
+   Array<int, AtomicReferenced> a;
+   for (int i=0; i<1000; i++)
+      a.add(i);
+
+   // every thread takes its own reference and writes to its own copy
+   bool ok[4]= {false, false, false, false};
+   std::thread threads[4];
+   for (int t=0; t<4; t++)
+   {
+      threads[t]= std::thread([&a, &ok, t]()
+      {
+         for (int i=0; i<1000; i++)
+         {
+            Array<int, AtomicReferenced> copy= a;
+            copy.add(t);
+            if (copy.size() != 1001 || copy[1000] != t || copy[999] != 999)
+               return;
+         }
+         ok[t]= true;
+      });
+   }
+   for (int t=0; t<4; t++)
+      threads[t].join();
+
+   CHECK(ok[0] && ok[1] && ok[2] && ok[3]);
+   CHECK(a.getRefCount() == 1 && a.size() == 1000);
+}
+
+
+static void testLayout()
+{
+   // small arrays are 16 byte aligned, large ones start at a cache line
+   Array<int> small(8, true);
+   Array<int> large(1024, true);
+   CHECK(isAligned(small.data(), Allocator::sMinAlignment));
+   CHECK(isAligned(large.data(), Allocator::sCacheLineSize));
+
+   // growing across the cache line threshold keeps the items
+   Array<int> grow;
+   for (int i=0; i<10000; i++)
+      grow.add(i);
+   CHECK(grow[9999] == 9999 && grow[123] == 123 && isAligned(grow.data(), Allocator::sCacheLineSize));
+
+   // padding is kept by assignments
+   Array<float> padded;
+   padded.setPadding(8);
+   padded.add(1.0f);
+   CHECK(padded.capacity() % 8 == 0);
+   Array<float> assigned;
+   assigned= padded;
+   CHECK(assigned.getPadding() == 8);
+   Array<float> moved;
+   moved= std::move(padded);
+   CHECK(moved.getPadding() == 8 && padded.size() == 0);
+
+   // owned data is counted with its header
+   Array<Vector3> counted(100, true);
+   CHECK(counted.getMemoryUsage() == Array<Vector3>::estimateMemoryUsage(counted.capacity()));
+   Array<int> empty;
+   CHECK(empty.getMemoryUsage() == 0 && empty.getRefCount() == 1);
+}
+
+
+static void testSmallArray()
+{
+   SmallArray<int, 4> a;
+   for (int i=0; i<4; i++)
+      a.add(i);
+   CHECK(a.isInline() && a.size() == 4);
+
+   a.add(a[0]);
+   CHECK(!a.isInline() && a.size() == 5 && a[4] == 0 && a[3] == 3);
+
+   // copies are deep
+   SmallArray<int, 4> b= a;
+   b[0]= 9;
+   CHECK(a[0] == 0 && b[0] == 9 && b.size() == 5);
+
+   SmallArray<std::string, 2> s;
+   for (int i=0; i<10; i++)
+      s.add(std::to_string(i));
+   s.removeAt(0);
+   CHECK(s.size() == 9 && s[0] == "1" && s.indexOf("9") == 8);
+}
+
+
+int main()
+{
+   testCopyOnWrite();
+   testSelfReference();
+   testRawData();
+   testArena();
+   testNonTrivial<Referenced>(Allocator::getHeap());
+   testNonTrivial<AtomicReferenced>(Allocator::getHeap());
+   {
+      Arena arena;
+      testNonTrivial<Referenced>(&arena);
+   }
+   testAtomicReferences();
+   testLayout();
+   testSmallArray();
+
+   printf("%s (%d failures)\n", failures ? "FAILED" : "ok", failures);
+   return failures;
+}
@@ -0,0 +1,20 @@
+# regression checks for Array, SmallArray and the allocators, no Qt needed
+# qmake arraytest.pro && make && ./arraytest
+
+TEMPLATE = app
+TARGET = arraytest
+DEPENDPATH += . ../src
+INCLUDEPATH += . ../src
+
+OBJECTS_DIR=.obj-arraytest
+
+CONFIG += console c++11 thread
+CONFIG -= qt app_bundle
+
+# DEFINES += ARRAY_STATISTICS
+
+SOURCES += \
+    arraytest.cpp \
+    ../src/allocator.cpp \
+    ../src/referenced.cpp \
+    ../src/arraystatistics.cpp